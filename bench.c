@@ -0,0 +1,648 @@
+// ============================================================================
+// FastMap Benchmarks
+//
+// Build: cc -O2 -o bench bench.c -lm -pthread
+// Usage: ./bench              (run everything with default sizes)
+//        ./bench <name> [n]   (run one benchmark, optionally with n entries)
+// ============================================================================
+
+#include <stdio.h>
+#include <time.h>
+#include "fastmap.h"
+
+// ============================================================================
+// BENCH HELPERS
+// ============================================================================
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Fills 'keys' with n distinct pseudo-random 64-bit keys
+static void random_keys(uint64_t* keys, size_t n, uint64_t seed) {
+    for (size_t i = 0; i < n; i++) keys[i] = splitmix64(&seed) | 1; // Odd: even keys are guaranteed misses
+}
+
+static void shuffle_keys(uint64_t* keys, size_t n, uint64_t seed) {
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = splitmix64(&seed) % (i + 1);
+        uint64_t t = keys[i]; keys[i] = keys[j]; keys[j] = t;
+    }
+}
+
+static volatile uint64_t bench_sink; // Keeps results observable
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile (0..1) of an already sorted sample array
+static uint64_t percentile(uint64_t* samples, size_t n, double p) {
+    size_t i = (size_t)(p * (double)(n - 1));
+    return samples[i];
+}
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+// Batched lookups vs a plain fm_get loop on a map larger than the LLC.
+// Half of the probes are hits (shuffled), half are guaranteed misses.
+static void bench_batch(size_t n) {
+    uint64_t* keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+    uint64_t* probes = (uint64_t*)malloc(n * sizeof(uint64_t));
+    void** out = (void**)malloc(n * sizeof(void*));
+    random_keys(keys, n, 1);
+
+    _FastMap map = FM_INIT(uint64_t, uint64_t);
+    for (size_t i = 0; i < n; i++) fm_put(&map, &keys[i], &keys[i]);
+
+    for (size_t i = 0; i < n; i++) probes[i] = (i % 2) ? keys[i] : keys[i] ^ 1;
+    shuffle_keys(probes, n, 2);
+
+    printf("batch: %zu entries, %zu lookups (50%% hits)\n", n, n);
+
+    uint64_t start = now_ns();
+    uint64_t found = 0;
+    for (size_t i = 0; i < n; i++) found += fm_get(&map, &probes[i]) != NULL;
+    double base_ns = (double)(now_ns() - start) / (double)n;
+    bench_sink = found;
+    printf("  %-18s %8.2f ns/op\n", "fm_get loop", base_ns);
+
+    size_t batch_sizes[] = { 64, 256, 1024 };
+    for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++) {
+        size_t bs = batch_sizes[b];
+        start = now_ns();
+        for (size_t i = 0; i < n; i += bs) {
+            fm_get_batch(&map, probes + i, (n - i < bs) ? n - i : bs, out + i);
+        }
+        double ns = (double)(now_ns() - start) / (double)n;
+
+        found = 0;
+        for (size_t i = 0; i < n; i++) found += out[i] != NULL;
+        bench_sink = found;
+        printf("  fm_get_batch(%4zu) %8.2f ns/op  (%.2fx)\n", bs, ns, base_ns / ns);
+    }
+
+    // Inserts into a fresh map, loop vs batch
+    fm_free(&map);
+    map = FM_INIT(uint64_t, uint64_t);
+    start = now_ns();
+    for (size_t i = 0; i < n; i++) fm_put(&map, &keys[i], &keys[i]);
+    double put_ns = (double)(now_ns() - start) / (double)n;
+    printf("  %-18s %8.2f ns/op\n", "fm_put loop", put_ns);
+
+    fm_free(&map);
+    map = FM_INIT(uint64_t, uint64_t);
+    start = now_ns();
+    for (size_t i = 0; i < n; i += 256) {
+        fm_put_batch(&map, keys + i, keys + i, (n - i < 256) ? n - i : 256);
+    }
+    double batch_put_ns = (double)(now_ns() - start) / (double)n;
+    printf("  fm_put_batch( 256) %8.2f ns/op  (%.2fx)\n", batch_put_ns, put_ns / batch_put_ns);
+
+    fm_free(&map);
+    free(keys);
+    free(probes);
+    free(out);
+}
+
+// Per-insert latency across growth events: blocking rehash vs incremental.
+static void bench_resize_latency(size_t n) {
+    uint64_t* keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+    uint64_t* lat = (uint64_t*)malloc(n * sizeof(uint64_t));
+    random_keys(keys, n, 3);
+
+    struct { const char* name; uint32_t flags; } modes[] = {
+        { "blocking",           0 },
+        { "incremental",        FM_OPT_INCREMENTAL },
+        { "blocking+packed",    FM_OPT_PACKED_BUCKETS },
+        { "incremental+packed", FM_OPT_INCREMENTAL | FM_OPT_PACKED_BUCKETS },
+    };
+
+    printf("resize_latency: %zu inserts from an empty map (ns per insert)\n", n);
+    printf("  %-20s %8s %8s %8s %8s %12s %10s\n", "mode", "p50", "p99", "p999", "p9999", "max", "mean");
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        fm_options opts = { .flags = modes[m].flags };
+        _FastMap map = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t t0 = now_ns();
+            fm_put(&map, &keys[i], &keys[i]);
+            lat[i] = now_ns() - t0;
+            total += lat[i];
+        }
+
+        qsort(lat, n, sizeof(uint64_t), cmp_u64);
+        printf("  %-20s %8llu %8llu %8llu %8llu %12llu %10.1f\n", modes[m].name,
+               (unsigned long long)percentile(lat, n, 0.50),
+               (unsigned long long)percentile(lat, n, 0.99),
+               (unsigned long long)percentile(lat, n, 0.999),
+               (unsigned long long)percentile(lat, n, 0.9999),
+               (unsigned long long)lat[n - 1],
+               (double)total / (double)n);
+        fm_free(&map);
+    }
+
+    free(keys);
+    free(lat);
+}
+
+// Key compares and ns/op for wide keys at fixed load factors. Keys share
+// everything but their last 8 bytes, so every false compare is a full one.
+static size_t bench_compares;
+
+static bool counting_eq(const _FastMap* map, const void* stored, const void* probe) {
+    bench_compares++;
+    return memcmp(stored, probe, map->key_size) == 0;
+}
+
+static void bench_key_compare(size_t n) {
+    size_t key_sizes[] = { 32, 64, 128 };
+    double loads[] = { 0.5, 0.6, 0.7, 0.8, 0.9 };
+    size_t buckets = 16;
+    while (buckets * 2 <= n) buckets *= 2;
+
+    printf("key_compare: %zu buckets, lookups of every key + as many misses\n", buckets);
+    printf("  %-5s %-5s %12s %12s %10s %10s\n", "key", "load", "cmp/hit", "cmp/miss", "hit ns", "miss ns");
+
+    for (size_t s = 0; s < sizeof(key_sizes) / sizeof(key_sizes[0]); s++) {
+        size_t ks = key_sizes[s];
+        for (size_t l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) {
+            size_t count = (size_t)(loads[l] * (double)buckets);
+            unsigned char* keys = (unsigned char*)malloc(2 * count * ks);
+            memset(keys, 0xAB, 2 * count * ks);
+            uint64_t seed = 4;
+            for (size_t i = 0; i < 2 * count; i++) {
+                uint64_t id = splitmix64(&seed);
+                id = (i < count) ? (id | 1) : (id & ~1ULL); // First half inserted, second half misses
+                memcpy(keys + i * ks + ks - 8, &id, 8);
+            }
+
+            _FastMap map = fm_init(ks, sizeof(uint64_t));
+            map.max_load_factor = 0.95f; // Let the table reach the target load
+            for (size_t i = 0; i < count; i++) fm_put(&map, keys + i * ks, &i);
+
+            double ns[2];
+            size_t cmps[2];
+            for (int miss = 0; miss < 2; miss++) {
+                const unsigned char* base = keys + (miss ? count * ks : 0);
+                bench_compares = 0;
+                uint64_t found = 0;
+                uint64_t start = now_ns();
+                for (size_t i = 0; i < count; i++) {
+                    const void* key = base + i * ks;
+                    found += fm_get_impl(&map, key, fm_hash(key, ks), ks, sizeof(uint64_t), counting_eq) != NULL;
+                }
+                ns[miss] = (double)(now_ns() - start) / (double)count;
+                cmps[miss] = bench_compares;
+                bench_sink = found;
+            }
+
+            printf("  %-5zu %-5.1f %12.3f %12.3f %10.2f %10.2f\n", ks, loads[l],
+                   (double)cmps[0] / (double)count, (double)cmps[1] / (double)count, ns[0], ns[1]);
+            fm_free(&map);
+            free(keys);
+        }
+    }
+}
+
+// fm_hash throughput by key length (short keys use the serial chain, longer
+// ones the striped path). Each call hashes a different window of a buffer.
+static void bench_hash(size_t n) {
+    size_t lens[] = { 8, 16, 32, 64, 90, 128, 256, 1024 };
+    unsigned char* buf = (unsigned char*)malloc(4096 + 1024);
+    uint64_t seed = 5;
+    for (size_t i = 0; i < 4096 + 1024; i++) buf[i] = (unsigned char)splitmix64(&seed);
+
+    printf("hash: %zu calls per length\n", n);
+    printf("  %-6s %10s %10s\n", "len", "ns/hash", "GB/s");
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        uint64_t acc = 0;
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < n; i++) acc += fm_hash(buf + ((i * 67) & 4095), lens[l]);
+        double ns = (double)(now_ns() - start) / (double)n;
+        bench_sink = acc;
+        printf("  %-6zu %10.2f %10.2f\n", lens[l], ns, (double)lens[l] / ns);
+    }
+    free(buf);
+}
+
+// Bulk load of n known entries: default growth vs fm_init_with_capacity
+static void bench_reserve(size_t n) {
+    uint64_t* keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+    random_keys(keys, n, 6);
+    printf("reserve: loading %zu entries\n", n);
+
+    for (int pre = 0; pre < 2; pre++) {
+        uint64_t start = now_ns();
+        _FastMap map = pre ? fm_init_with_capacity(sizeof(uint64_t), sizeof(uint64_t), n)
+                           : fm_init(sizeof(uint64_t), sizeof(uint64_t));
+        for (size_t i = 0; i < n; i++) fm_put(&map, &keys[i], &keys[i]);
+        double ms = (double)(now_ns() - start) / 1e6;
+        printf("  %-22s %10.1f ms  (%.1f ns/entry)\n", pre ? "fm_init_with_capacity" : "fm_init", ms,
+               ms * 1e6 / (double)n);
+        fm_free(&map);
+    }
+    free(keys);
+}
+
+// Loading n pairs from arrays: fm_put per element (pre-sized) vs fm_build
+static void bench_build(size_t n) {
+    uint64_t* keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+    random_keys(keys, n, 7);
+    printf("build: %zu entries from parallel arrays\n", n);
+
+    for (int mode = 0; mode < 3; mode++) {
+        uint64_t start = now_ns();
+        _FastMap map = fm_init(sizeof(uint64_t), sizeof(uint64_t));
+        if (mode == 0) {
+            fm_reserve(&map, n);
+            for (size_t i = 0; i < n; i++) fm_put(&map, &keys[i], &keys[i]);
+        } else {
+            fm_build(&map, keys, keys, n, mode == 1 ? FM_BUILD_UNIQUE : 0);
+        }
+        double ms = (double)(now_ns() - start) / 1e6;
+        const char* names[] = { "fm_reserve + fm_put", "fm_build (unique)", "fm_build (dedup)" };
+        printf("  %-22s %10.1f ms  (%.1f ns/entry)\n", names[mode], ms, ms * 1e6 / (double)n);
+        fm_free(&map);
+    }
+    free(keys);
+}
+
+// Full index rebuild from the dense vectors: the old dense-order reinsert
+// against the bucket-order sweep fm_resize uses for large maps. Sizes step
+// by 10x from 1M up to n; keys are 32-bit and generated in place to keep
+// 100M within reach of a modest machine.
+static void bench_rebuild(size_t n) {
+    printf("rebuild: index rebuild into 2x buckets, dense order vs bucket order\n");
+    for (size_t size = 1000000; size <= n; size *= 10) {
+        for (int packed = 0; packed < 2; packed++) {
+            fm_options opts = { .flags = packed ? FM_OPT_PACKED_BUCKETS : 0 };
+            _FastMap map = fm_init_ex(sizeof(uint32_t), sizeof(uint32_t), &opts);
+            fm_reserve(&map, size);
+            for (size_t i = 0; i < size; i++) {
+                uint32_t key = (uint32_t)i * 0x9E3779B1u; // Odd multiplier: distinct keys
+                uint32_t val = (uint32_t)i;
+                fm_put(&map, &key, &val);
+            }
+
+            double ms[2];
+            for (int mode = 0; mode < 2; mode++) {
+                fm_table t = fm_table_alloc(map.table.bucket_count * 2, map.flags, map.allocator);
+                uint64_t start = now_ns();
+                bool ok = mode ? fm_rebuild_bucket_order(&map, &t) : fm_rebuild_dense(&map, &t);
+                ms[mode] = (double)(now_ns() - start) / 1e6;
+                if (!ok) printf("  (packed distance overflow)\n");
+                fm_table_free(&t);
+            }
+            printf("  %-6s %11zu entries  dense %9.1f ms  bucket-order %9.1f ms  (%.2fx)\n",
+                   packed ? "packed" : "plain", size, ms[0], ms[1], ms[0] / ms[1]);
+            fflush(stdout);
+            fm_free(&map);
+        }
+    }
+}
+
+// Blocking resize to 2x buckets with 1..16 rebuild threads (pthreads)
+static void bench_rebuild_parallel(size_t n) {
+    printf("rebuild_parallel: fm_resize of %zu entries into 2x buckets\n", n);
+    _FastMap map = fm_init(sizeof(uint32_t), sizeof(uint32_t));
+    fm_reserve(&map, n);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t key = (uint32_t)i * 0x9E3779B1u;
+        uint32_t val = (uint32_t)i;
+        fm_put(&map, &key, &val);
+    }
+    size_t buckets = map.table.bucket_count;
+
+    double base = 0;
+    for (uint32_t threads = 1; threads <= 16; threads *= 2) {
+        map.resize_threads = threads; // Same loaded map throughout: switch in place
+        uint64_t start = now_ns();
+        fm_resize(&map, buckets * 2);
+        double ms = (double)(now_ns() - start) / 1e6;
+        if (threads == 1) base = ms;
+        printf("  %2u threads %9.1f ms  (%.2fx)\n", threads, ms, base / ms);
+        fflush(stdout);
+        fm_resize(&map, buckets); // Back to the original size
+    }
+    fm_free(&map);
+}
+
+// Pass-through allocator that counts requests and live bytes
+typedef struct {
+    size_t calls;
+    size_t live;
+} bench_heap;
+
+static void* bench_alloc(void* ctx, size_t size) {
+    bench_heap* h = (bench_heap*)ctx;
+    h->calls++;
+    h->live += size;
+    return malloc(size);
+}
+
+static void* bench_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    bench_heap* h = (bench_heap*)ctx;
+    h->calls++;
+    h->live = h->live - old_size + new_size;
+    return realloc(ptr, new_size);
+}
+
+static void bench_free(void* ctx, void* ptr, size_t size) {
+    ((bench_heap*)ctx)->live -= size;
+    free(ptr);
+}
+
+// Many small maps, separate vectors vs FM_OPT_FUSED: bytes requested per
+// entry once loaded, allocator calls per map and the cost of init + puts.
+// n is the total number of entries across all maps of one size.
+static void bench_fused(size_t n) {
+    static const size_t SIZES[] = { 8, 100, 1000, 4096, 10000 };
+    uint64_t* keys = (uint64_t*)malloc(10000 * sizeof(uint64_t));
+    random_keys(keys, 10000, 8);
+    printf("fused: %zu entries per size, maps of 8..10000 uint64 -> uint64\n", n);
+    printf("  %-8s %-9s %12s %12s %12s\n", "entries", "layout", "bytes/entry", "allocs/map", "ns/insert");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        size_t size = SIZES[s], maps = n / size ? n / size : 1;
+        for (int fused = 0; fused < 2; fused++) {
+            bench_heap heap = { 0, 0 };
+            fm_allocator alloc = { bench_alloc, bench_realloc, bench_free, &heap };
+            fm_options opts = { .flags = fused ? FM_OPT_FUSED : 0, .allocator = &alloc };
+            size_t bytes = 0;
+            uint64_t elapsed = 0;
+            for (size_t m = 0; m < maps; m++) {
+                uint64_t start = now_ns();
+                _FastMap map = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+                for (size_t i = 0; i < size; i++) fm_put(&map, &keys[i], &keys[i]);
+                elapsed += now_ns() - start;
+                bytes += heap.live;
+                fm_free(&map);
+            }
+            printf("  %-8zu %-9s %12.1f %12.1f %12.1f\n", size, fused ? "fused" : "separate",
+                   (double)bytes / (double)(maps * size), (double)heap.calls / (double)maps,
+                   (double)elapsed / (double)(maps * size));
+            fflush(stdout);
+        }
+    }
+    free(keys);
+}
+
+// Many short-lived maps of a few entries (per-request attribute maps):
+// init, 'size' puts, 'size' hits and 'size' misses, free. Default index
+// vs FM_OPT_SMALL, which scans cached hashes and allocates one block.
+static void bench_small(size_t n) {
+    static const size_t SIZES[] = { 1, 3, 5, 8 };
+    printf("small: %zu maps per size, create + put + get + free\n", n);
+    printf("  %-8s %-8s %12s %12s %12s\n", "entries", "layout", "ns/map", "allocs/map", "bytes/map");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        size_t size = SIZES[s];
+        uint64_t keys[16];
+        random_keys(keys, 16, 9);
+        for (int small = 0; small < 2; small++) {
+            bench_heap heap = { 0, 0 };
+            fm_allocator alloc = { bench_alloc, bench_realloc, bench_free, &heap };
+            fm_options opts = { .flags = small ? FM_OPT_SMALL : 0, .allocator = &alloc };
+            size_t bytes = 0;
+            uint64_t found = 0, start = now_ns();
+            for (size_t m = 0; m < n; m++) {
+                keys[0] = m | 1; // Vary the maps a little
+                _FastMap map = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+                for (size_t i = 0; i < size; i++) fm_put(&map, &keys[i], &keys[i]);
+                for (size_t i = 0; i < size; i++) {
+                    uint64_t miss = keys[i] + 1; // Even: never stored
+                    found += fm_get(&map, &keys[i]) != NULL;
+                    found += fm_get(&map, &miss) != NULL;
+                }
+                bytes += heap.live;
+                fm_free(&map);
+            }
+            double ns = (double)(now_ns() - start) / (double)n;
+            bench_sink += found;
+            printf("  %-8zu %-8s %12.1f %12.1f %12.1f\n", size, small ? "small" : "default", ns,
+                   (double)heap.calls / (double)n, (double)bytes / (double)n);
+            fflush(stdout);
+        }
+    }
+}
+
+// Cost of the index width chosen at compile time: run this benchmark in
+// both bench (32-bit) and bench_index64 (FM_INDEX_64). Reports index bytes
+// per entry, inserts into a growing map and shuffled hits, for plain and
+// packed buckets.
+static void bench_index(size_t n) {
+    uint64_t* keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+    random_keys(keys, n, 10);
+    printf("index: %zu-bit vector indices, %zu entries\n", sizeof(fm_index) * 8, n);
+
+    for (int packed = 0; packed < 2; packed++) {
+        fm_options opts = { .flags = packed ? FM_OPT_PACKED_BUCKETS : 0 };
+        _FastMap map = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < n; i++) fm_put(&map, &keys[i], &keys[i]);
+        double put_ns = (double)(now_ns() - start) / (double)n;
+
+        shuffle_keys(keys, n, 11);
+        uint64_t found = 0;
+        start = now_ns();
+        for (size_t i = 0; i < n; i++) found += fm_get(&map, &keys[i]) != NULL;
+        double get_ns = (double)(now_ns() - start) / (double)n;
+        bench_sink += found;
+
+        fm_stats_t st;
+        fm_stats(&map, &st);
+        printf("  %-7s index %5.2f B/entry  total %6.2f B/entry  put %6.1f ns  get %6.1f ns\n",
+               packed ? "packed" : "plain", (double)st.bytes_buckets / (double)n, (double)st.bytes_total / (double)n,
+               put_ns, get_ns);
+        fflush(stdout);
+        fm_free(&map);
+    }
+    free(keys);
+}
+
+// Index footprint and hit latency of maps up to a few tens of thousands of
+// entries, default 4-byte buckets vs FM_OPT_COMPACT_INDEX (1 byte up to 256
+// buckets, 2 up to 65536). 'n' lookups per size, spread over enough maps
+// that the working set is the same for both.
+static void bench_compact(size_t n) {
+    static const size_t SIZES[] = { 10, 100, 1000, 10000, 50000 };
+    printf("compact: %zu lookups per size\n", n);
+    printf("  %-8s %-8s %12s %12s %12s\n", "entries", "layout", "index B/ent", "total B/ent", "get ns");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        size_t size = SIZES[s], maps = ((size_t)1 << 20) / size ? ((size_t)1 << 20) / size : 1;
+        uint64_t* keys = (uint64_t*)malloc(size * sizeof(uint64_t));
+        random_keys(keys, size, 12);
+        for (int compact = 0; compact < 2; compact++) {
+            fm_options opts = { .flags = compact ? FM_OPT_COMPACT_INDEX : 0 };
+            _FastMap* all = (_FastMap*)malloc(maps * sizeof(_FastMap));
+            for (size_t m = 0; m < maps; m++) {
+                all[m] = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+                for (size_t i = 0; i < size; i++) fm_put(&all[m], &keys[i], &keys[i]);
+            }
+
+            uint64_t found = 0, state = 13, start = now_ns();
+            for (size_t i = 0; i < n; i++) {
+                uint64_t r = splitmix64(&state);
+                found += fm_get(&all[r % maps], &keys[(r >> 32) % size]) != NULL;
+            }
+            double get_ns = (double)(now_ns() - start) / (double)n;
+            bench_sink += found;
+
+            fm_stats_t st;
+            fm_stats(&all[0], &st);
+            printf("  %-8zu %-8s %12.2f %12.2f %12.1f\n", size, compact ? "compact" : "default",
+                   (double)st.bytes_buckets / (double)size, (double)st.bytes_total / (double)size, get_ns);
+            fflush(stdout);
+            for (size_t m = 0; m < maps; m++) fm_free(&all[m]);
+            free(all);
+        }
+        free(keys);
+    }
+}
+
+// Cached hashes vs FM_OPT_NO_HASH_CACHE for int -> int and uint64 ->
+// uint64 maps: memory per entry, inserts into a growing map (every resize
+// rehashes the keys), shuffled hits and erases.
+static void bench_hash_cache(size_t n) {
+    uint64_t* keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+    random_keys(keys, n, 14);
+    printf("hash_cache: %zu entries\n", n);
+    printf("  %-8s %-8s %12s %12s %12s %12s\n", "key", "hashes", "B/entry", "put ns", "get ns", "erase ns");
+
+    for (size_t ks = 4; ks <= 8; ks += 4) {
+        for (int cached = 1; cached >= 0; cached--) {
+            fm_options opts = { .flags = cached ? 0 : FM_OPT_NO_HASH_CACHE };
+            _FastMap map = fm_init_ex(ks, ks, &opts);
+            uint64_t start = now_ns();
+            for (size_t i = 0; i < n; i++) fm_put(&map, &keys[i], &keys[i]); // Low bytes when ks == 4
+            double put_ns = (double)(now_ns() - start) / (double)n;
+
+            fm_stats_t st;
+            fm_stats(&map, &st);
+            shuffle_keys(keys, n, 15);
+            uint64_t found = 0;
+            start = now_ns();
+            for (size_t i = 0; i < n; i++) found += fm_get(&map, &keys[i]) != NULL;
+            double get_ns = (double)(now_ns() - start) / (double)n;
+            start = now_ns();
+            for (size_t i = 0; i < n; i++) found += fm_erase(&map, &keys[i]);
+            double erase_ns = (double)(now_ns() - start) / (double)n;
+            bench_sink += found;
+
+            printf("  %-8s %-8s %12.2f %12.1f %12.1f %12.1f\n", ks == 4 ? "uint32" : "uint64",
+                   cached ? "cached" : "none", (double)st.bytes_total / (double)st.size, put_ns, get_ns, erase_ns);
+            fflush(stdout);
+            fm_free(&map);
+        }
+    }
+    free(keys);
+}
+
+// Per-backend cost (fm_options.hash): ns per hash of 4, 8 and 16-byte keys,
+// then put / get on a map of n random uint64 keys. Backends the CPU lacks
+// resolve to wy and are reported as such.
+static void bench_hash_backends(size_t n) {
+    static const fm_hash_kind KINDS[] = { FM_HASH_WY, FM_HASH_CRC32C, FM_HASH_AES, FM_HASH_MULSHIFT };
+    static const char* NAMES[] = { "wy", "crc32c", "aes", "mulshift" };
+    unsigned char buf[4096 + 16];
+    uint64_t seed = 16;
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (unsigned char)splitmix64(&seed);
+    uint64_t* keys = (uint64_t*)malloc(n * sizeof(uint64_t));
+    random_keys(keys, n, 17);
+
+    printf("hash_backends: %zu hashes per size, %zu-entry map\n", n, n);
+    printf("  %-9s %10s %10s %10s %10s %10s\n", "backend", "4B ns", "8B ns", "16B ns", "put ns", "get ns");
+    for (size_t k = 0; k < sizeof(KINDS) / sizeof(KINDS[0]); k++) {
+        fm_hash_kind kind = fm_hash_resolve(KINDS[k]);
+        double hash_ns[3];
+        for (int z = 0; z < 3; z++) {
+            size_t len = (size_t)4 << z;
+            uint64_t acc = 0, start = now_ns();
+            for (size_t i = 0; i < n; i++) acc += fm_hash_as(kind, buf + ((i * 67) & 4095), len);
+            hash_ns[z] = (double)(now_ns() - start) / (double)n;
+            bench_sink += acc;
+        }
+
+        fm_options opts = { .hash = KINDS[k] };
+        _FastMap map = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < n; i++) fm_put(&map, &keys[i], &keys[i]);
+        double put_ns = (double)(now_ns() - start) / (double)n;
+        shuffle_keys(keys, n, 18);
+        uint64_t found = 0;
+        start = now_ns();
+        for (size_t i = 0; i < n; i++) found += fm_get(&map, &keys[i]) != NULL;
+        double get_ns = (double)(now_ns() - start) / (double)n;
+        bench_sink += found;
+        fm_free(&map);
+
+        printf("  %-9s %10.2f %10.2f %10.2f %10.1f %10.1f%s\n", NAMES[k], hash_ns[0], hash_ns[1], hash_ns[2],
+               put_ns, get_ns, kind == KINDS[k] ? "" : "  (unavailable: wy)");
+        fflush(stdout);
+    }
+    free(keys);
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+typedef struct {
+    const char* name;
+    void (*run)(size_t n);
+    size_t default_n;
+} bench_case;
+
+static const bench_case BENCHES[] = {
+    { "batch",          bench_batch,          (size_t)1 << 23 },
+    { "resize_latency", bench_resize_latency, (size_t)1 << 23 },
+    { "key_compare",    bench_key_compare,    (size_t)1 << 20 },
+    { "hash",           bench_hash,           (size_t)1 << 24 },
+    { "reserve",        bench_reserve,        (size_t)10000000 },
+    { "build",          bench_build,          (size_t)10000000 },
+    { "rebuild",        bench_rebuild,        (size_t)100000000 },
+    { "rebuild_parallel", bench_rebuild_parallel, (size_t)1 << 25 },
+    { "fused",          bench_fused,          (size_t)1 << 22 },
+    { "small",          bench_small,          (size_t)1 << 21 },
+    { "index",          bench_index,          (size_t)1 << 24 },
+    { "compact",        bench_compact,        (size_t)1 << 23 },
+    { "hash_cache",     bench_hash_cache,     (size_t)1 << 22 },
+    { "hash_backends",  bench_hash_backends,  (size_t)1 << 22 },
+};
+
+int main(int argc, char** argv) {
+    size_t count = sizeof(BENCHES) / sizeof(BENCHES[0]);
+    const char* only = argc > 1 ? argv[1] : NULL;
+    size_t n = argc > 2 ? (size_t)strtoull(argv[2], NULL, 10) : 0;
+
+    bool ran = false;
+    for (size_t i = 0; i < count; i++) {
+        if (only && strcmp(only, BENCHES[i].name) != 0) continue;
+        BENCHES[i].run(n ? n : BENCHES[i].default_n);
+        ran = true;
+    }
+
+    if (!ran) {
+        fprintf(stderr, "unknown benchmark '%s'; available:", only);
+        for (size_t i = 0; i < count; i++) fprintf(stderr, " %s", BENCHES[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    return 0;
+}
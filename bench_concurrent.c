@@ -0,0 +1,239 @@
+// ============================================================================
+// fm_concurrent scaling benchmark
+//
+// Build: cc -std=c11 -O2 -o bench_concurrent bench_concurrent.c -lm -pthread
+// Usage: ./bench_concurrent [ops] [max_threads]
+//
+// Runs a fixed total number of operations split across 1, 2, 4 .. max_threads
+// threads, for a read-heavy and a write-heavy mix, on a 64-shard map and on a
+// single-shard map (the "one global lock" baseline). A last table measures
+// read throughput against reader count with one updater thread running, for
+// fm_seqmap (lock-free readers) against the 64-shard rwlock map. The last
+// one builds a dedup table from a shared key stream (every key appears
+// twice): fm_cmap against insert-if-absent on the sharded map.
+// ============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "fastmap_concurrent.h"
+
+#define KEY_SPACE (1u << 20)
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+typedef struct {
+    const char* name;
+    uint32_t read_pct;  // Remaining operations split evenly between put and erase
+} mix;
+
+typedef struct {
+    fm_concurrent* map;
+    const mix* m;
+    size_t ops;
+    uint64_t seed;
+    uint64_t hits;
+} worker_arg;
+
+static void* worker(void* p) {
+    worker_arg* a = (worker_arg*)p;
+    uint64_t state = a->seed, hits = 0;
+    for (size_t i = 0; i < a->ops; i++) {
+        uint64_t r = splitmix64(&state);
+        uint64_t key = r % KEY_SPACE, val = r;
+        uint32_t roll = (uint32_t)((r >> 32) % 100);
+        if (roll < a->m->read_pct) {
+            hits += fm_concurrent_get_copy(a->map, &key, &val);
+        } else if ((roll - a->m->read_pct) % 2 == 0) {
+            fm_concurrent_put(a->map, &key, &val);
+        } else {
+            fm_concurrent_erase(a->map, &key);
+        }
+    }
+    a->hits = hits;
+    return NULL;
+}
+
+static double run(size_t shards, const mix* m, size_t threads, size_t ops) {
+    fm_concurrent map = fm_concurrent_init(sizeof(uint64_t), sizeof(uint64_t), shards, NULL);
+    for (uint64_t k = 0; k < KEY_SPACE; k += 2) fm_concurrent_put(&map, &k, &k); // Half full
+
+    pthread_t ids[256];
+    worker_arg args[256];
+    uint64_t start = now_ns();
+    for (size_t t = 0; t < threads; t++) {
+        worker_arg a = { &map, m, ops / threads, 1234 + t, 0 };
+        args[t] = a;
+        if (pthread_create(&ids[t], NULL, worker, &args[t]) != 0) abort();
+    }
+    for (size_t t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+    double secs = (double)(now_ns() - start) / 1e9;
+
+    fm_concurrent_free(&map);
+    return (double)(ops / threads * threads) / secs / 1e6;
+}
+
+// --- Read scaling with one writer ---
+
+typedef struct {
+    fm_seqmap* seq;       // One of the two is set
+    fm_concurrent* locked;
+    size_t ops;
+    uint64_t seed;
+} reader_arg;
+
+static atomic_bool writer_stop;
+
+static void* reader(void* p) {
+    reader_arg* a = (reader_arg*)p;
+    fm_seq_reader r;
+    if (a->seq) r = fm_seqmap_reader(a->seq);
+    uint64_t state = a->seed, hits = 0;
+    for (size_t i = 0; i < a->ops; i++) {
+        uint64_t key = splitmix64(&state) % KEY_SPACE, val;
+        hits += a->seq ? fm_seqmap_get_copy(&r, &key, &val) : fm_concurrent_get_copy(a->locked, &key, &val);
+    }
+    if (a->seq) fm_seqmap_reader_release(&r);
+    return (void*)(uintptr_t)hits;
+}
+
+// Rewrites existing values at roughly 1% of the readers' rate
+static void* writer(void* p) {
+    reader_arg* a = (reader_arg*)p;
+    uint64_t state = a->seed;
+    struct timespec pause = { 0, 20000 };
+    while (!atomic_load_explicit(&writer_stop, memory_order_relaxed)) {
+        uint64_t key = (splitmix64(&state) % KEY_SPACE) & ~1ull, val = state;
+        if (a->seq) fm_seqmap_put(a->seq, &key, &val);
+        else fm_concurrent_put(a->locked, &key, &val);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+static double run_readers(bool seqlock, size_t threads, size_t ops) {
+    fm_seqmap* seq = seqlock ? fm_seqmap_create(sizeof(uint64_t), sizeof(uint64_t), NULL) : NULL;
+    fm_concurrent locked = fm_concurrent_init(sizeof(uint64_t), sizeof(uint64_t), 64, NULL);
+    for (uint64_t k = 0; k < KEY_SPACE; k += 2) {
+        if (seq) fm_seqmap_put(seq, &k, &k);
+        else fm_concurrent_put(&locked, &k, &k);
+    }
+
+    pthread_t ids[256], writer_id;
+    reader_arg args[256], wa = { seq, &locked, 0, 99 };
+    atomic_store(&writer_stop, false);
+    if (pthread_create(&writer_id, NULL, writer, &wa) != 0) abort();
+    uint64_t start = now_ns();
+    for (size_t t = 0; t < threads; t++) {
+        reader_arg a = { seq, &locked, ops / threads, 1234 + t };
+        args[t] = a;
+        if (pthread_create(&ids[t], NULL, reader, &args[t]) != 0) abort();
+    }
+    for (size_t t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+    double secs = (double)(now_ns() - start) / 1e9;
+    atomic_store(&writer_stop, true);
+    pthread_join(writer_id, NULL);
+
+    if (seq) fm_seqmap_destroy(seq);
+    fm_concurrent_free(&locked);
+    return (double)(ops / threads * threads) / secs / 1e6;
+}
+
+// --- Parallel ingest / dedup ---
+
+typedef struct {
+    fm_cmap* cmap;         // One of the two is set
+    fm_concurrent* locked;
+    size_t begin, end;     // Slice of the key stream
+} ingest_arg;
+
+static void keep_first(void* value, bool existed, void* user) {
+    if (!existed) *(uint64_t*)value = *(const uint64_t*)user;
+}
+
+static void* ingest(void* p) {
+    ingest_arg* a = (ingest_arg*)p;
+    for (size_t i = a->begin; i < a->end; i++) {
+        uint64_t state = i >> 1; // Keys i and i^1 are equal
+        uint64_t key = splitmix64(&state);
+        if (a->cmap) fm_cmap_insert(a->cmap, &key, &i, NULL);
+        else fm_concurrent_update(a->locked, &key, keep_first, &i);
+    }
+    return NULL;
+}
+
+// 0 shards: fm_cmap. Both start empty and grow.
+static double run_ingest(size_t shards, size_t threads, size_t ops) {
+    fm_cmap* cmap = shards ? NULL : fm_cmap_create(sizeof(uint64_t), sizeof(uint64_t), 0);
+    fm_concurrent locked = fm_concurrent_init(sizeof(uint64_t), sizeof(uint64_t), shards ? shards : 1, NULL);
+
+    pthread_t ids[256];
+    ingest_arg args[256];
+    uint64_t start = now_ns();
+    for (size_t t = 0; t < threads; t++) {
+        ingest_arg a = { cmap, &locked, ops * t / threads, ops * (t + 1) / threads };
+        args[t] = a;
+        if (pthread_create(&ids[t], NULL, ingest, &args[t]) != 0) abort();
+    }
+    for (size_t t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+    double secs = (double)(now_ns() - start) / 1e9;
+
+    size_t unique = cmap ? fm_cmap_size(cmap) : fm_concurrent_size(&locked);
+    if (unique != (ops + 1) / 2) abort(); // Both must dedup exactly
+    if (cmap) fm_cmap_destroy(cmap);
+    fm_concurrent_free(&locked);
+    return (double)ops / secs / 1e6;
+}
+
+int main(int argc, char** argv) {
+    size_t ops = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : (size_t)1 << 23;
+    size_t max_threads = argc > 2 ? (size_t)strtoull(argv[2], NULL, 10) : 64;
+    if (max_threads > 256) max_threads = 256;
+
+    static const mix MIXES[] = {
+        { "read-heavy (90% get)", 90 },
+        { "write-heavy (20% get)", 20 },
+    };
+
+    printf("fm_concurrent: %zu ops total, %u keys, Mops/s\n", ops, KEY_SPACE);
+    for (size_t i = 0; i < sizeof(MIXES) / sizeof(MIXES[0]); i++) {
+        printf("\n%s\n  %-8s %12s %12s %8s\n", MIXES[i].name, "threads", "64 shards", "1 shard", "ratio");
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            double sharded = run(64, &MIXES[i], threads, ops);
+            double global = run(1, &MIXES[i], threads, ops);
+            printf("  %-8zu %12.2f %12.2f %7.2fx\n", threads, sharded, global, sharded / global);
+            fflush(stdout);
+        }
+    }
+
+    printf("\nread scaling, 1 writer thread\n  %-8s %12s %12s %8s\n", "readers", "seqmap", "64 shards", "ratio");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double seq = run_readers(true, threads, ops);
+        double locked = run_readers(false, threads, ops);
+        printf("  %-8zu %12.2f %12.2f %7.2fx\n", threads, seq, locked, seq / locked);
+        fflush(stdout);
+    }
+
+    printf("\ningest / dedup (%zu keys, %zu unique)\n  %-8s %12s %12s %12s\n", ops, (ops + 1) / 2, "threads",
+           "fm_cmap", "64 shards", "1 shard");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double cas = run_ingest(0, threads, ops);
+        double sharded = run_ingest(64, threads, ops);
+        double global = run_ingest(1, threads, ops);
+        printf("  %-8zu %12.2f %12.2f %12.2f\n", threads, cas, sharded, global);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+// ============================================================================
+// fastmap::dense_map vs std::unordered_map
+//
+// Build: c++ -O2 -std=c++17 -o bench_dense_map bench_dense_map.cpp
+// Usage: ./bench_dense_map [n]
+// ============================================================================
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "fastmap.hpp"
+
+// ============================================================================
+// BENCH HELPERS
+// ============================================================================
+
+static uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static volatile uint64_t bench_sink; // Keeps results observable
+
+struct Key16 {
+    uint64_t a, b;
+    bool operator==(const Key16& o) const { return a == o.a && b == o.b; }
+};
+
+// Same hash for both maps so the comparison is about the table, not the hash
+struct Key16Hash {
+    using is_avalanching = void;
+    uint64_t operator()(const Key16& k) const noexcept { return fm_hash(&k, sizeof(k)); }
+};
+
+template <class F>
+static double time_ns_per_op(size_t ops, F&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return (double)ns / (double)ops;
+}
+
+// Insert all keys, look up hits and misses, erase half
+template <class Map, class K>
+static void run_map(const char* label, const std::vector<K>& keys, const std::vector<K>& misses) {
+    size_t n = keys.size();
+    Map map;
+    double insert = time_ns_per_op(n, [&] {
+        for (size_t i = 0; i < n; i++) map.insert_or_assign(keys[i], (uint64_t)i);
+    });
+    double hit = time_ns_per_op(n, [&] {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; i++) sum += map.find(keys[i])->second;
+        bench_sink = sum;
+    });
+    double miss = time_ns_per_op(n, [&] {
+        uint64_t found = 0;
+        for (size_t i = 0; i < n; i++) found += map.find(misses[i]) != map.end();
+        bench_sink = found;
+    });
+    double erase = time_ns_per_op(n / 2, [&] {
+        for (size_t i = 0; i < n; i += 2) map.erase(keys[i]);
+    });
+    printf("  %-22s %8.2f %8.2f %8.2f %8.2f\n", label, insert, hit, miss, erase);
+}
+
+template <class K, class Hash, class Gen>
+static void run_key_type(const char* name, size_t n, Gen&& gen) {
+    std::vector<K> keys, misses;
+    uint64_t seed = 1;
+    for (size_t i = 0; i < n; i++) keys.push_back(gen(seed, true));
+    for (size_t i = 0; i < n; i++) misses.push_back(gen(seed, false));
+
+    printf("%s keys: %zu entries (ns/op)\n", name, n);
+    printf("  %-22s %8s %8s %8s %8s\n", "map", "insert", "hit", "miss", "erase");
+    run_map<fastmap::dense_map<K, uint64_t, Hash>>("fastmap::dense_map", keys, misses);
+    run_map<std::unordered_map<K, uint64_t, Hash>>("std::unordered_map", keys, misses);
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : (size_t)1 << 20;
+
+    // Hits have the low bit set, misses cleared, so the sets never overlap
+    run_key_type<uint64_t, fastmap::hash<uint64_t>>("int", n, [](uint64_t& s, bool hit) {
+        uint64_t k = splitmix64(s);
+        return hit ? k | 1 : k & ~1ULL;
+    });
+    run_key_type<Key16, Key16Hash>("16-byte struct", n, [](uint64_t& s, bool hit) {
+        uint64_t a = splitmix64(s);
+        return Key16{ hit ? a | 1 : a & ~1ULL, splitmix64(s) };
+    });
+    run_key_type<std::string, fastmap::hash<std::string>>("string", n, [](uint64_t& s, bool hit) {
+        return std::string(hit ? "key:" : "miss:") + std::to_string(splitmix64(s));
+    });
+    return 0;
+}
@@ -0,0 +1,609 @@
+// ============================================================================
+// FastMap Benchmark Suite
+//
+// Runs every (map, key type, distribution, size) case in its own process so
+// peak RSS is per case, and prints one row per operation.
+//
+// Build: make bench        (or c++ -O2 -std=c++17 -o bench_suite bench_suite.cpp)
+// Usage: ./bench_suite [--format table|csv|json] [--sizes 1000,1000000,...]
+//                      [--maps fastmap,dense_map,unordered_map,open_addressing]
+//                      [--keys int,struct,string]
+//                      [--dists uniform,sequential,zipfian,adversarial]
+//                      [--csv FILE] [--json FILE]
+// --format picks what goes to stdout; --csv / --json also write the same
+// rows to a file, so one run can produce every format.
+//
+// Operations (ns/op):
+//   insert      fresh map, all keys
+//   hit / miss  lookups of present / absent keys in distribution order
+//   mixed       50% hit lookups, 25% inserts, 25% erases of earlier inserts
+//   iterate     visit every entry (ns per entry)
+//   erase       erase every key
+// bytes_per_entry counts the map's own heap memory (not the key arrays);
+// peak_rss_kb is the case's process peak, key arrays included.
+// ============================================================================
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fastmap.h"
+#include "fastmap.hpp"
+
+// ============================================================================
+// BENCH HELPERS
+// ============================================================================
+
+static uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static volatile uint64_t bench_sink; // Keeps results observable
+
+static uint64_t now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static long peak_rss_kb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss; // Kilobytes on Linux
+}
+
+// Every timed phase runs at least this many operations (small maps repeat)
+static const size_t MIN_OPS = (size_t)1 << 20;
+
+// ============================================================================
+// KEY TYPES & DISTRIBUTIONS
+// ============================================================================
+
+struct Key16 {
+    uint64_t a, b;
+    bool operator==(const Key16& o) const { return a == o.a && b == o.b; }
+};
+
+struct Key16Hash {
+    using is_avalanching = void;
+    uint64_t operator()(const Key16& k) const noexcept { return fm_hash(&k, sizeof(k)); }
+};
+
+template <class K> struct key_traits;
+
+template <> struct key_traits<uint64_t> {
+    using hasher = fastmap::hash<uint64_t>;
+    static uint64_t make(uint64_t id) { return id; }
+};
+
+template <> struct key_traits<Key16> {
+    using hasher = Key16Hash;
+    static Key16 make(uint64_t id) { return Key16{ id, id * 0xD6E8FEB86659FD93ULL }; }
+};
+
+template <> struct key_traits<std::string> {
+    using hasher = fastmap::hash<std::string>;
+    static std::string make(uint64_t id) { return "user/" + std::to_string(id) + "/profile"; }
+};
+
+enum Dist { DIST_UNIFORM, DIST_SEQUENTIAL, DIST_ZIPFIAN, DIST_ADVERSARIAL };
+
+// 2n distinct ids: the first n are inserted, the rest are guaranteed misses.
+//   uniform / zipfian  pseudo-random ids
+//   sequential         0, 1, 2, ...
+//   adversarial        i << 32: identical low 32 bits, defeats hashes that
+//                      only look at (or mask) the low bits
+static std::vector<uint64_t> make_ids(Dist dist, size_t n) {
+    std::vector<uint64_t> ids(2 * n);
+    uint64_t seed = 1;
+    for (size_t i = 0; i < 2 * n; i++) {
+        switch (dist) {
+            case DIST_SEQUENTIAL:  ids[i] = i; break;
+            case DIST_ADVERSARIAL: ids[i] = (uint64_t)i << 32; break;
+            default:               ids[i] = (splitmix64(seed) & ~1ULL) | (i < n); break; // Hit/miss never collide
+        }
+    }
+    return ids;
+}
+
+// Zipfian ranks over [0, n) with skew 0.99 (Gray et al., as used by YCSB)
+struct zipf_gen {
+    double theta = 0.99, alpha, zetan, eta;
+    size_t n;
+    uint64_t state = 7;
+
+    explicit zipf_gen(size_t items) : n(items) {
+        double zeta2 = 1.0 + std::pow(0.5, theta);
+        zetan = 0;
+        for (size_t i = 1; i <= n; i++) zetan += 1.0 / std::pow((double)i, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    size_t next() {
+        double u = (double)(splitmix64(state) >> 11) * (1.0 / 9007199254740992.0);
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return 1;
+        size_t r = (size_t)((double)n * std::pow(eta * u - eta + 1.0, alpha));
+        return r < n ? r : n - 1;
+    }
+};
+
+// Order in which lookups visit the inserted keys
+static std::vector<uint32_t> make_probe_order(Dist dist, size_t n, size_t ops) {
+    std::vector<uint32_t> order(ops);
+    uint64_t seed = 2;
+    if (dist == DIST_ZIPFIAN) {
+        zipf_gen z(n);
+        for (size_t i = 0; i < ops; i++) order[i] = (uint32_t)z.next();
+    } else if (dist == DIST_SEQUENTIAL) {
+        for (size_t i = 0; i < ops; i++) order[i] = (uint32_t)(i % n);
+    } else {
+        for (size_t i = 0; i < ops; i++) order[i] = (uint32_t)(splitmix64(seed) % n);
+    }
+    return order;
+}
+
+// ============================================================================
+// OPEN-ADDRESSING BASELINE
+// Linear probing over one array of (key, value) slots with tombstones, the
+// textbook design the dense/sparse split is measured against.
+// ============================================================================
+
+template <class K, class V, class Hash>
+class oa_map {
+    enum : uint8_t { FREE, FULL, DELETED };
+    struct slot { K key; V value; };
+
+    std::vector<slot> slots_;
+    std::vector<uint8_t> state_;
+    size_t size_ = 0, used_ = 0, mask_ = 0; // 'used_' counts tombstones too
+    Hash hash_;
+
+    void grow() {
+        std::vector<slot> old_slots = std::move(slots_);
+        std::vector<uint8_t> old_state = std::move(state_);
+        // Double when live entries are the problem; otherwise just drop tombstones
+        size_t cap = old_slots.size();
+        if (cap == 0) cap = 16;
+        else if ((size_ + 1) * 20 > cap * 7) cap *= 2;
+        slots_ = std::vector<slot>(cap);
+        state_.assign(cap, FREE);
+        mask_ = cap - 1;
+        size_ = used_ = 0;
+        for (size_t i = 0; i < old_slots.size(); i++) {
+            if (old_state[i] == FULL) insert(std::move(old_slots[i].key), std::move(old_slots[i].value));
+        }
+    }
+
+public:
+    V* find(const K& key) {
+        if (slots_.empty()) return nullptr;
+        for (size_t i = hash_(key) & mask_;; i = (i + 1) & mask_) {
+            if (state_[i] == FREE) return nullptr;
+            if (state_[i] == FULL && slots_[i].key == key) return &slots_[i].value;
+        }
+    }
+
+    // True if the key was new (like insert_or_assign(...).second)
+    bool insert(K key, V value) {
+        if ((used_ + 1) * 10 > slots_.size() * 7) grow(); // Max load 0.7
+        size_t tomb = (size_t)-1;
+        for (size_t i = hash_(key) & mask_;; i = (i + 1) & mask_) {
+            if (state_[i] == FULL && slots_[i].key == key) { slots_[i].value = std::move(value); return false; }
+            if (state_[i] == DELETED && tomb == (size_t)-1) tomb = i;
+            if (state_[i] == FREE) {
+                if (tomb == (size_t)-1) { tomb = i; used_++; }
+                slots_[tomb].key = std::move(key);
+                slots_[tomb].value = std::move(value);
+                state_[tomb] = FULL;
+                size_++;
+                return true;
+            }
+        }
+    }
+
+    bool erase(const K& key) {
+        if (slots_.empty()) return false;
+        for (size_t i = hash_(key) & mask_;; i = (i + 1) & mask_) {
+            if (state_[i] == FREE) return false;
+            if (state_[i] == FULL && slots_[i].key == key) {
+                state_[i] = DELETED;
+                slots_[i].key = K();
+                size_--;
+                return true;
+            }
+        }
+    }
+
+    template <class F>
+    void for_each(F&& fn) {
+        for (size_t i = 0; i < slots_.size(); i++) {
+            if (state_[i] == FULL) fn(slots_[i].value);
+        }
+    }
+
+    size_t bytes() const { return slots_.capacity() * sizeof(slot) + state_.capacity(); }
+};
+
+// ============================================================================
+// MAP ADAPTERS
+// Each adapter exposes: insert(k, v), find(k) -> uint64_t*, erase(k),
+// sum_values(), bytes().
+// ============================================================================
+
+// Counts live heap bytes for the std:: containers
+static size_t g_alloc_bytes;
+
+template <class T>
+struct counting_alloc {
+    using value_type = T;
+    counting_alloc() = default;
+    template <class U> counting_alloc(const counting_alloc<U>&) {}
+    T* allocate(size_t n) { g_alloc_bytes += n * sizeof(T); return std::allocator<T>().allocate(n); }
+    void deallocate(T* p, size_t n) { g_alloc_bytes -= n * sizeof(T); std::allocator<T>().deallocate(p, n); }
+    template <class U> bool operator==(const counting_alloc<U>&) const { return true; }
+    template <class U> bool operator!=(const counting_alloc<U>&) const { return false; }
+};
+
+// std::string keys hold their own heap buffers; count them like the map does
+static size_t key_heap_bytes(const std::string& s) { return s.capacity() > 15 ? s.capacity() + 1 : 0; }
+template <class K> static size_t key_heap_bytes(const K&) { return 0; }
+
+// The C API: fm_put / fm_get / fm_erase (string keys use the arena mode)
+template <class K>
+struct fastmap_c {
+    _FastMap map;
+
+    fastmap_c() {
+        if constexpr (std::is_same_v<K, std::string>) map = fm_init_str(sizeof(uint64_t), nullptr);
+        else map = fm_init(sizeof(K), sizeof(uint64_t));
+    }
+    ~fastmap_c() { fm_free(&map); }
+
+    void insert(const K& k, uint64_t v) {
+        if constexpr (std::is_same_v<K, std::string>) fm_put_str(&map, k.data(), k.size(), &v);
+        else fm_put(&map, &k, &v);
+    }
+    uint64_t* find(const K& k) {
+        if constexpr (std::is_same_v<K, std::string>) return (uint64_t*)fm_get_str(&map, k.data(), k.size());
+        else return (uint64_t*)fm_get(&map, &k);
+    }
+    bool erase(const K& k) {
+        if constexpr (std::is_same_v<K, std::string>) return fm_erase_str(&map, k.data(), k.size());
+        else return fm_erase(&map, &k);
+    }
+    uint64_t sum_values() {
+        const uint64_t* v = (const uint64_t*)map.values.data;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < map.values.length; i++) sum += v[i];
+        return sum;
+    }
+    size_t bytes() const {
+        fm_stats_t st;
+        fm_stats(&map, &st);
+        return st.bytes_total;
+    }
+};
+
+template <class K>
+struct dense_map_cpp {
+    fastmap::dense_map<K, uint64_t, typename key_traits<K>::hasher, std::equal_to<>,
+                       counting_alloc<std::pair<const K, uint64_t>>> map;
+    size_t key_bytes = 0;
+
+    void insert(const K& k, uint64_t v) {
+        if (map.insert_or_assign(k, v).second) key_bytes += key_heap_bytes(k);
+    }
+    uint64_t* find(const K& k) { auto it = map.find(k); return it == map.end() ? nullptr : &it->second; }
+    bool erase(const K& k) { return map.erase(k) == 1; }
+    uint64_t sum_values() { uint64_t s = 0; for (auto kv : map) s += kv.second; return s; }
+    size_t bytes() const { return g_alloc_bytes + key_bytes; }
+};
+
+template <class K>
+struct unordered_map_cpp {
+    std::unordered_map<K, uint64_t, typename key_traits<K>::hasher, std::equal_to<K>,
+                       counting_alloc<std::pair<const K, uint64_t>>> map;
+    size_t key_bytes = 0;
+
+    void insert(const K& k, uint64_t v) {
+        if (map.insert_or_assign(k, v).second) key_bytes += key_heap_bytes(k);
+    }
+    uint64_t* find(const K& k) { auto it = map.find(k); return it == map.end() ? nullptr : &it->second; }
+    bool erase(const K& k) { return map.erase(k) == 1; }
+    uint64_t sum_values() { uint64_t s = 0; for (auto& kv : map) s += kv.second; return s; }
+    size_t bytes() const { return g_alloc_bytes + key_bytes; }
+};
+
+template <class K>
+struct open_addressing_cpp {
+    oa_map<K, uint64_t, typename key_traits<K>::hasher> map;
+    size_t key_bytes = 0;
+
+    void insert(const K& k, uint64_t v) {
+        if (map.insert(k, v)) key_bytes += key_heap_bytes(k);
+    }
+    uint64_t* find(const K& k) { return map.find(k); }
+    bool erase(const K& k) { return map.erase(k); }
+    uint64_t sum_values() { uint64_t s = 0; map.for_each([&](uint64_t v) { s += v; }); return s; }
+    size_t bytes() const { return map.bytes() + key_bytes; }
+};
+
+// ============================================================================
+// RESULTS
+// ============================================================================
+
+enum Format { FMT_TABLE, FMT_CSV, FMT_JSON };
+
+struct bench_case {
+    const char* map;
+    const char* key;
+    const char* dist;
+    size_t size;
+};
+
+// Where rows go: stdout in --format, plus one file per --csv / --json
+struct sink {
+    Format format;
+    FILE* out;
+    bool first_row; // No ",\n" before the first JSON row
+};
+
+static std::vector<sink> g_sinks;
+
+static void print_header() {
+    for (const sink& s : g_sinks) {
+        if (s.format == FMT_CSV) {
+            fprintf(s.out, "map,key,dist,size,op,ns_per_op,bytes_per_entry,peak_rss_kb\n");
+        } else if (s.format == FMT_TABLE) {
+            fprintf(s.out, "%-16s %-7s %-12s %11s %-8s %10s %10s %12s\n",
+                    "map", "key", "dist", "size", "op", "ns/op", "B/entry", "peak_rss_kb");
+        } else {
+            fprintf(s.out, "[\n");
+        }
+    }
+}
+
+static void print_footer() {
+    for (const sink& s : g_sinks) {
+        if (s.format == FMT_JSON) fprintf(s.out, "\n]\n");
+    }
+}
+
+static void print_row(const bench_case& c, const char* op, double ns, double bpe, long rss) {
+    for (sink& s : g_sinks) {
+        switch (s.format) {
+            case FMT_CSV:
+                fprintf(s.out, "%s,%s,%s,%zu,%s,%.2f,%.1f,%ld\n", c.map, c.key, c.dist, c.size, op, ns, bpe, rss);
+                break;
+            case FMT_JSON:
+                fprintf(s.out, "%s  {\"map\":\"%s\",\"key\":\"%s\",\"dist\":\"%s\",\"size\":%zu,\"op\":\"%s\","
+                        "\"ns_per_op\":%.2f,\"bytes_per_entry\":%.1f,\"peak_rss_kb\":%ld}",
+                        s.first_row ? "" : ",\n", c.map, c.key, c.dist, c.size, op, ns, bpe, rss);
+                break;
+            default:
+                fprintf(s.out, "%-16s %-7s %-12s %11zu %-8s %10.2f %10.1f %12ld\n",
+                        c.map, c.key, c.dist, c.size, op, ns, bpe, rss);
+                break;
+        }
+        s.first_row = false;
+    }
+}
+
+// ============================================================================
+// THE WORKLOADS
+// ============================================================================
+
+template <class Map, class K>
+static void run_case(const bench_case& c, Dist dist) {
+    size_t n = c.size;
+    size_t rounds = n >= MIN_OPS ? 1 : MIN_OPS / n;
+    size_t lookups = n * rounds;
+
+    std::vector<uint64_t> ids = make_ids(dist, n);
+    std::vector<K> keys(2 * n);
+    for (size_t i = 0; i < 2 * n; i++) keys[i] = key_traits<K>::make(ids[i]);
+    std::vector<uint64_t>().swap(ids);
+    std::vector<uint32_t> order = make_probe_order(dist, n, lookups);
+
+    struct result { const char* op; double ns; };
+    std::vector<result> results;
+    double bytes_per_entry = 0;
+
+    // insert (each round builds a fresh map; the last one is kept)
+    Map* map = nullptr;
+    uint64_t total = 0;
+    for (size_t r = 0; r < rounds; r++) {
+        delete map;
+        map = new Map();
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < n; i++) map->insert(keys[i], i);
+        total += now_ns() - start;
+    }
+    results.push_back({ "insert", (double)total / (double)(n * rounds) });
+    bytes_per_entry = (double)map->bytes() / (double)n;
+
+    // hit
+    uint64_t start = now_ns();
+    uint64_t acc = 0;
+    for (size_t i = 0; i < lookups; i++) acc += *map->find(keys[order[i]]);
+    results.push_back({ "hit", (double)(now_ns() - start) / (double)lookups });
+
+    // miss
+    start = now_ns();
+    for (size_t i = 0; i < lookups; i++) acc += map->find(keys[n + order[i]]) != nullptr;
+    results.push_back({ "miss", (double)(now_ns() - start) / (double)lookups });
+
+    // mixed: the erased key was inserted 'window' write-ops earlier. At most
+    // window + 1 of the n extra keys are live, so every insert is a new key.
+    const size_t window = n / 2 < 1024 ? n / 2 : 1024;
+    size_t ins = 0, del = 0;
+    start = now_ns();
+    for (size_t i = 0; i < lookups; i++) {
+        switch (i & 3) {
+            case 0: case 1: acc += map->find(keys[order[i]]) != nullptr; break;
+            case 2: map->insert(keys[n + (ins++ % n)], i); break;
+            case 3:
+                if (ins > del + window) map->erase(keys[n + (del++ % n)]);
+                break;
+        }
+    }
+    results.push_back({ "mixed", (double)(now_ns() - start) / (double)lookups });
+    while (del < ins) map->erase(keys[n + (del++ % n)]);
+
+    // iterate
+    start = now_ns();
+    for (size_t r = 0; r < rounds; r++) acc += map->sum_values();
+    results.push_back({ "iterate", (double)(now_ns() - start) / (double)(n * rounds) });
+
+    // erase (rebuilds between rounds are not timed)
+    total = 0;
+    for (size_t r = 0; r < rounds; r++) {
+        if (r > 0) {
+            delete map;
+            map = new Map();
+            for (size_t i = 0; i < n; i++) map->insert(keys[i], i);
+        }
+        start = now_ns();
+        for (size_t i = 0; i < n; i++) map->erase(keys[i]);
+        total += now_ns() - start;
+    }
+    results.push_back({ "erase", (double)total / (double)(n * rounds) });
+    delete map;
+    bench_sink = acc;
+
+    long rss = peak_rss_kb();
+    for (const result& r : results) print_row(c, r.op, r.ns, bytes_per_entry, rss);
+}
+
+template <class K>
+static void run_key(const bench_case& c, Dist dist) {
+    if (!strcmp(c.map, "fastmap")) run_case<fastmap_c<K>, K>(c, dist);
+    else if (!strcmp(c.map, "dense_map")) run_case<dense_map_cpp<K>, K>(c, dist);
+    else if (!strcmp(c.map, "unordered_map")) run_case<unordered_map_cpp<K>, K>(c, dist);
+    else if (!strcmp(c.map, "open_addressing")) run_case<open_addressing_cpp<K>, K>(c, dist);
+    else { fprintf(stderr, "unknown map '%s'\n", c.map); exit(1); }
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+static Format parse_format(const char* s) {
+    return !strcmp(s, "csv") ? FMT_CSV : !strcmp(s, "json") ? FMT_JSON : FMT_TABLE;
+}
+
+// Every name must be one of 'known'; checked before any case forks
+static bool check_names(const char* what, const std::vector<std::string>& names,
+                        const std::vector<std::string>& known) {
+    for (const std::string& name : names) {
+        bool found = false;
+        for (const std::string& k : known) found = found || k == name;
+        if (!found) {
+            fprintf(stderr, "unknown %s '%s'\n", what, name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<std::string> split_list(const char* s) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (; *s; s++) {
+        if (*s == ',') { out.push_back(cur); cur.clear(); }
+        else cur += *s;
+    }
+    if (!cur.empty()) out.push_back(cur);
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> maps = { "fastmap", "dense_map", "unordered_map", "open_addressing" };
+    std::vector<std::string> key_types = { "int", "struct", "string" };
+    std::vector<std::string> dists = { "uniform", "sequential", "zipfian", "adversarial" };
+    std::vector<size_t> sizes = { 1000, 100000, 1000000, 10000000 }; // Up to 100M via --sizes
+    const std::vector<std::string> all_maps = maps, all_keys = key_types, all_dists = dists;
+
+    Format format = FMT_TABLE;
+    for (int i = 1; i < argc; i++) {
+        const char* val = i + 1 < argc ? argv[i + 1] : "";
+        if (!strcmp(argv[i], "--format")) {
+            format = parse_format(val);
+        } else if (!strcmp(argv[i], "--csv") || !strcmp(argv[i], "--json")) {
+            FILE* out = fopen(val, "w");
+            if (!out) {
+                fprintf(stderr, "cannot write '%s'\n", val);
+                return 1;
+            }
+            g_sinks.push_back({ parse_format(argv[i] + 2), out, true });
+        } else if (!strcmp(argv[i], "--sizes")) {
+            sizes.clear();
+            for (const std::string& s : split_list(val)) sizes.push_back((size_t)strtoull(s.c_str(), nullptr, 10));
+        } else if (!strcmp(argv[i], "--maps")) {
+            maps = split_list(val);
+        } else if (!strcmp(argv[i], "--keys")) {
+            key_types = split_list(val);
+        } else if (!strcmp(argv[i], "--dists")) {
+            dists = split_list(val);
+        } else {
+            fprintf(stderr, "unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+        i++;
+    }
+    if (!check_names("map", maps, all_maps) || !check_names("key type", key_types, all_keys) ||
+        !check_names("distribution", dists, all_dists)) {
+        return 1;
+    }
+    g_sinks.insert(g_sinks.begin(), { format, stdout, true });
+
+    print_header();
+    for (size_t size : sizes) {
+        for (const std::string& key : key_types) {
+            for (const std::string& dist_name : dists) {
+                Dist dist = dist_name == "sequential" ? DIST_SEQUENTIAL : dist_name == "zipfian" ? DIST_ZIPFIAN
+                          : dist_name == "adversarial" ? DIST_ADVERSARIAL : DIST_UNIFORM;
+                for (const std::string& map : maps) {
+                    bench_case c = { map.c_str(), key.c_str(), dist_name.c_str(), size };
+
+                    // One process per case: isolated peak RSS, and a crash or
+                    // OOM at 100M entries only loses that case
+                    fflush(nullptr);
+                    pid_t pid = fork();
+                    if (pid == 0) {
+                        if (key == "int") run_key<uint64_t>(c, dist);
+                        else if (key == "struct") run_key<Key16>(c, dist);
+                        else run_key<std::string>(c, dist);
+                        fflush(nullptr);
+                        _exit(0);
+                    }
+                    int status = 0;
+                    waitpid(pid, &status, 0);
+                    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                        fprintf(stderr, "case %s/%s/%s/%zu failed\n", c.map, c.key, c.dist, size);
+                        continue;
+                    }
+                    // The child printed rows; its first_row flags died with it
+                    for (sink& s : g_sinks) s.first_row = false;
+                }
+            }
+        }
+    }
+    print_footer();
+    for (size_t i = 1; i < g_sinks.size(); i++) fclose(g_sinks[i].out);
+    return 0;
+}
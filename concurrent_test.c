@@ -0,0 +1,278 @@
+// ============================================================================
+// fm_concurrent tests
+//
+// Build: cc -std=c11 -O2 -o concurrent_test concurrent_test.c -lm -pthread
+// ============================================================================
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+#include "fastmap_concurrent.h"
+
+#define ASSERT_EQ(expect, actual, format) \
+    do { \
+        if ((expect) != (actual)) { \
+            fprintf(stderr, "FAILED %s:%d: Expected " format ", got " format "\n", \
+                    __FILE__, __LINE__, (expect), (actual)); \
+            abort(); \
+        } \
+    } while(0)
+
+#define LOG_PASS(name) printf("[PASS] %s\n", name)
+
+#define THREADS 8
+#define PER_THREAD 20000
+#define SHARED_KEYS 64
+#define INCREMENTS 6400 // A multiple of SHARED_KEYS
+
+typedef struct {
+    fm_concurrent* map;
+    uint64_t id;
+} worker_arg;
+
+static void add_one(void* value, bool existed, void* user) {
+    (void)existed;
+    (void)user;
+    (*(uint64_t*)value)++;
+}
+
+// Disjoint puts / gets / erases, plus increments of keys every thread shares
+static void* worker(void* p) {
+    worker_arg* a = (worker_arg*)p;
+    uint64_t base = (a->id + 1) << 32;
+
+    for (uint64_t i = 0; i < PER_THREAD; i++) {
+        uint64_t key = base + i, val = i * 3;
+        fm_concurrent_put(a->map, &key, &val);
+    }
+    for (uint64_t i = 0; i < PER_THREAD; i++) {
+        uint64_t key = base + i, val = 0;
+        assert(fm_concurrent_get_copy(a->map, &key, &val) && val == i * 3);
+        if (i % 2 == 0) assert(fm_concurrent_erase(a->map, &key));
+    }
+    for (uint64_t i = 0; i < INCREMENTS; i++) {
+        uint64_t key = i % SHARED_KEYS;
+        fm_concurrent_update(a->map, &key, add_one, NULL);
+    }
+    return NULL;
+}
+
+static void run_workers(fm_concurrent* map) {
+    pthread_t ids[THREADS];
+    worker_arg args[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        args[t].map = map;
+        args[t].id = (uint64_t)t;
+        assert(pthread_create(&ids[t], NULL, worker, &args[t]) == 0);
+    }
+    for (int t = 0; t < THREADS; t++) pthread_join(ids[t], NULL);
+}
+
+static void check_contents(fm_concurrent* map) {
+    ASSERT_EQ((size_t)(THREADS * PER_THREAD / 2 + SHARED_KEYS), fm_concurrent_size(map), "%zu");
+    for (uint64_t t = 0; t < THREADS; t++) {
+        for (uint64_t i = 0; i < PER_THREAD; i++) {
+            uint64_t key = ((t + 1) << 32) + i, val = 0;
+            bool found = fm_concurrent_get_copy(map, &key, &val);
+            assert(i % 2 == 0 ? !found : (found && val == i * 3));
+        }
+    }
+    for (uint64_t k = 0; k < SHARED_KEYS; k++) {
+        uint64_t val = 0;
+        assert(fm_concurrent_get_copy(map, &k, &val));
+        ASSERT_EQ((unsigned long long)(THREADS * INCREMENTS / SHARED_KEYS), (unsigned long long)val, "%llu");
+    }
+}
+
+void test_sharded() {
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS, FM_OPT_INCREMENTAL, 0 };
+    fm_hash_kind hashes[] = { FM_HASH_WY, FM_HASH_WY, FM_HASH_WY, FM_HASH_WY, FM_HASH_FAST };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l], .hash = hashes[l] };
+        fm_concurrent map = fm_concurrent_init(sizeof(uint64_t), sizeof(uint64_t), 16, &opts);
+        run_workers(&map);
+        check_contents(&map);
+        fm_concurrent_free(&map);
+    }
+    LOG_PASS("Sharded Map (5 layouts, 16 shards)");
+}
+
+void test_single_shard() {
+    fm_concurrent map = fm_concurrent_init(sizeof(uint64_t), sizeof(uint64_t), 1, NULL);
+    ASSERT_EQ((size_t)0, map.shard_mask, "%zu");
+    run_workers(&map);
+    check_contents(&map);
+    fm_concurrent_free(&map);
+    LOG_PASS("Single Shard (global lock)");
+}
+
+void test_shard_routing() {
+    // Rounded up to a power of two, capped, and every shard gets keys
+    fm_concurrent map = fm_concurrent_init(sizeof(uint64_t), sizeof(uint64_t), 100, NULL);
+    ASSERT_EQ((size_t)127, map.shard_mask, "%zu");
+    for (uint64_t i = 0; i < 100000; i++) fm_concurrent_put(&map, &i, &i);
+    for (size_t s = 0; s <= map.shard_mask; s++) assert(map.shards[s].map.keys.length > 0);
+    for (size_t s = 0; s <= map.shard_mask; s++) assert((uintptr_t)&map.shards[s] % FM_CACHE_LINE == 0);
+    fm_concurrent_free(&map);
+
+    map = fm_concurrent_init(sizeof(uint64_t), sizeof(uint64_t), 100000, NULL);
+    ASSERT_EQ((size_t)FM_CONCURRENT_MAX_SHARDS - 1, map.shard_mask, "%zu");
+    fm_concurrent_free(&map);
+    LOG_PASS("Shard Routing");
+}
+
+// --- fm_seqmap ---
+
+#define SEQ_KEYS 200000
+#define SEQ_READERS 4
+
+typedef struct {
+    uint64_t key;
+    uint64_t check; // key * 3: a torn read would break the pair
+} seq_value;
+
+static atomic_bool seq_done;
+
+static void* seq_reader(void* p) {
+    fm_seqmap* m = (fm_seqmap*)p;
+    fm_seq_reader r = fm_seqmap_reader(m);
+    uint64_t state = (uint64_t)(uintptr_t)&r, found = 0;
+    while (!atomic_load(&seq_done)) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t key = (state >> 33) % SEQ_KEYS;
+        seq_value v;
+        if (fm_seqmap_get_copy(&r, &key, &v)) {
+            assert(v.key == key && v.check == key * 3);
+            found++;
+        }
+    }
+    fm_seqmap_reader_release(&r);
+    return (void*)(uintptr_t)found;
+}
+
+void test_seqmap() {
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+        fm_seqmap* m = fm_seqmap_create(sizeof(uint64_t), sizeof(seq_value), &opts);
+        atomic_store(&seq_done, false);
+        pthread_t ids[SEQ_READERS];
+        for (int t = 0; t < SEQ_READERS; t++) assert(pthread_create(&ids[t], NULL, seq_reader, m) == 0);
+
+        // Grow through many resizes while readers probe, then churn
+        for (uint64_t k = 0; k < SEQ_KEYS; k++) {
+            seq_value v = { k, k * 3 };
+            fm_seqmap_put(m, &k, &v);
+        }
+        for (uint64_t k = 0; k < SEQ_KEYS; k += 2) assert(fm_seqmap_erase(m, &k));
+        for (uint64_t k = 0; k < SEQ_KEYS; k += 4) {
+            seq_value v = { k, k * 3 };
+            fm_seqmap_put(m, &k, &v);
+        }
+        assert(!fm_seqmap_erase(m, &(uint64_t){ SEQ_KEYS + 1 }));
+
+        atomic_store(&seq_done, true);
+        for (int t = 0; t < SEQ_READERS; t++) pthread_join(ids[t], NULL);
+
+        // With no reader left, the next write frees everything retired
+        uint64_t k = 1;
+        seq_value v = { k, k * 3 };
+        fm_seqmap_put(m, &k, &v);
+        fm_seqmap_reserve(m, 0);
+        ASSERT_EQ((size_t)0, m->retired.length, "%zu");
+
+        fm_seq_reader r = fm_seqmap_reader(m);
+        for (uint64_t key = 0; key < SEQ_KEYS; key++) {
+            bool expect = key % 2 == 1 || key % 4 == 0;
+            assert(fm_seqmap_get_copy(&r, &key, &v) == expect);
+            if (expect) assert(v.key == key && v.check == key * 3);
+        }
+        fm_seqmap_reader_release(&r);
+        fm_seqmap_destroy(m);
+    }
+    LOG_PASS("Seqlock Map (single writer, lock-free readers)");
+}
+
+// --- fm_cmap ---
+
+#define CMAP_THREADS 8
+#define CMAP_KEYS 300000   // Each thread inserts an overlapping half of these
+
+typedef struct {
+    fm_cmap* m;
+    uint64_t id;
+    uint64_t inserted;
+} cmap_arg;
+
+static void* cmap_worker(void* p) {
+    cmap_arg* a = (cmap_arg*)p;
+    uint64_t start = a->id * CMAP_KEYS / CMAP_THREADS; // Ranges overlap and wrap around
+    for (uint64_t i = 0; i < CMAP_KEYS / 2; i++) {
+        uint64_t key = (start + i * 7 % (CMAP_KEYS / 2)) % CMAP_KEYS; // Each range in a stride-7 order
+        uint64_t val = (a->id << 32) | key;
+        size_t idx;
+        if (fm_cmap_insert(a->m, &key, &val, &idx)) a->inserted++;
+
+        const void* stored_key;
+        const void* stored;
+        assert(fm_cmap_at(a->m, idx, &stored_key, &stored) && *(const uint64_t*)stored_key == key);
+        const uint64_t* got = (const uint64_t*)fm_cmap_get(a->m, &key);
+        assert(got == stored && (*got & 0xFFFFFFFFu) == key); // Whichever thread won, it stays
+    }
+    return NULL;
+}
+
+void test_cmap() {
+    fm_cmap* m = fm_cmap_create(sizeof(uint64_t), sizeof(uint64_t), 0); // Grows many times
+    pthread_t ids[CMAP_THREADS];
+    cmap_arg args[CMAP_THREADS];
+    for (int t = 0; t < CMAP_THREADS; t++) {
+        cmap_arg a = { m, (uint64_t)t, 0 };
+        args[t] = a;
+        assert(pthread_create(&ids[t], NULL, cmap_worker, &args[t]) == 0);
+    }
+    uint64_t inserted = 0;
+    for (int t = 0; t < CMAP_THREADS; t++) {
+        pthread_join(ids[t], NULL);
+        inserted += args[t].inserted;
+    }
+
+    // The ranges cover every key, each inserted exactly once
+    ASSERT_EQ((unsigned long long)CMAP_KEYS, (unsigned long long)inserted, "%llu");
+    ASSERT_EQ((size_t)CMAP_KEYS, fm_cmap_size(m), "%zu");
+
+    unsigned char* seen = (unsigned char*)calloc(CMAP_KEYS, 1);
+    size_t live = 0;
+    for (size_t i = 0; i < fm_cmap_reserved(m); i++) {
+        const void* key;
+        const void* value;
+        if (!fm_cmap_at(m, i, &key, &value)) continue;
+        uint64_t k = *(const uint64_t*)key;
+        assert(k < CMAP_KEYS && !seen[k] && (*(const uint64_t*)value & 0xFFFFFFFFu) == k);
+        seen[k] = 1;
+        live++;
+    }
+    ASSERT_EQ((size_t)CMAP_KEYS, live, "%zu");
+    uint64_t missing = CMAP_KEYS;
+    assert(fm_cmap_get(m, &missing) == NULL);
+
+    free(seen);
+    fm_cmap_destroy(m);
+    LOG_PASS("Insert-only Map (CAS claiming, cooperative growth)");
+}
+
+int main() {
+    printf("=== fm_concurrent Test Suite ===\n");
+
+    test_sharded();
+    test_single_shard();
+    test_shard_routing();
+#if !defined(__SANITIZE_THREAD__) // TSan cannot model the seqlock's fences
+    test_seqmap();
+#endif
+    test_cmap();
+
+    printf("=== All Tests Passed ===\n");
+    return 0;
+}
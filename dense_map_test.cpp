@@ -0,0 +1,154 @@
+// ============================================================================
+// fastmap::dense_map tests
+//
+// Build: c++ -std=c++17 -O2 -o dense_map_test dense_map_test.cpp
+// ============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include "fastmap.hpp"
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while(0)
+
+#define LOG_PASS(name) printf("[PASS] %s\n", name)
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_basic_ops() {
+    fastmap::dense_map<int, int> map;
+    for (int i = 0; i < 10000; i++) CHECK(map.try_emplace(i, i * 2).second);
+    CHECK(map.size() == 10000);
+    CHECK(!map.try_emplace(5, 0).second);
+    CHECK(map.at(5) == 10);
+
+    auto r = map.insert_or_assign(5, 55);
+    CHECK(!r.second && r.first->second == 55);
+    map[20000] = 7;
+    CHECK(map.at(20000) == 7);
+
+    for (int i = 0; i < 10000; i += 2) CHECK(map.erase(i) == 1);
+    CHECK(map.erase(0) == 0);
+    for (int i = 0; i < 10000; i++) CHECK(map.contains(i) == (i % 2 == 1));
+
+    bool threw = false;
+    try { map.at(0); } catch (const std::out_of_range&) { threw = true; }
+    CHECK(threw);
+
+    size_t visited = 0;
+    for (auto kv : map) { CHECK(map.at(kv.first) == kv.second); visited++; }
+    CHECK(visited == map.size());
+    LOG_PASS("dense_map Basic Ops");
+}
+
+void test_move_only_values() {
+    fastmap::dense_map<int, std::unique_ptr<int>> map;
+    for (int i = 0; i < 5000; i++) map.try_emplace(i, std::make_unique<int>(i));
+
+    // Swap-and-pop moves the tail element into the erased slot
+    for (int i = 0; i < 5000; i += 3) map.erase(i);
+    for (int i = 0; i < 5000; i++) {
+        auto it = map.find(i);
+        if (i % 3 == 0) CHECK(it == map.end());
+        else CHECK(it != map.end() && *it->second == i);
+    }
+
+    fastmap::dense_map<int, std::unique_ptr<int>> moved = std::move(map);
+    CHECK(map.empty() && moved.size() == 3333);
+    map.try_emplace(1, std::make_unique<int>(1)); // Moved-from map is reusable
+    CHECK(*map.at(1) == 1);
+    LOG_PASS("dense_map Move-Only Values");
+}
+
+void test_string_keys() {
+    fastmap::dense_map<std::string, int> map;
+    map.try_emplace("apple", 1);
+    map.try_emplace(std::string("banana"), 2);
+    map["a fairly long key that does not fit into SSO storage"] = 3;
+
+    // Heterogeneous lookup: no std::string temporaries
+    std::string_view sv = "banana";
+    CHECK(map.find(sv) != map.end() && map.find(sv)->second == 2);
+    CHECK(map.contains("apple"));
+    CHECK(map.at("a fairly long key that does not fit into SSO storage") == 3);
+    CHECK(map.erase(std::string_view("apple")) == 1);
+    CHECK(!map.contains("apple") && map.size() == 2);
+    LOG_PASS("dense_map String Keys");
+}
+
+void test_against_reference() {
+    fastmap::dense_map<uint64_t, uint64_t> map;
+    std::unordered_map<uint64_t, uint64_t> ref;
+    uint64_t state = 42;
+    for (int op = 0; op < 200000; op++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t key = (state >> 33) % 4096;
+        switch ((state >> 20) % 3) {
+            case 0: map.insert_or_assign(key, state); ref[key] = state; break;
+            case 1: CHECK(map.erase(key) == ref.erase(key)); break;
+            case 2: {
+                auto it = map.find(key);
+                auto rit = ref.find(key);
+                CHECK((it == map.end()) == (rit == ref.end()));
+                if (rit != ref.end()) CHECK(it->second == rit->second);
+                break;
+            }
+        }
+        CHECK(map.size() == ref.size());
+    }
+    LOG_PASS("dense_map Fuzz vs std::unordered_map");
+}
+
+// Throws from its constructor for negative inputs
+struct picky_value {
+    int v;
+    explicit picky_value(int x) : v(x) {
+        if (x < 0) throw std::runtime_error("picky_value");
+    }
+};
+
+void test_exception_safety() {
+    fastmap::dense_map<int, picky_value> map;
+    for (int i = 0; i < 3000; i++) {
+        map.try_emplace(i, i);
+        bool threw = false;
+        try {
+            map.try_emplace(100000 + i, -1); // Key and hash were pushed first
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK(threw && map.size() == (size_t)i + 1);
+    }
+
+    // Any leftover hash or key would misplace later entries
+    for (int i = 0; i < 3000; i += 2) CHECK(map.erase(i) == 1);
+    for (int i = 0; i < 3000; i++) {
+        auto it = map.find(i);
+        if (i % 2 == 0) CHECK(it == map.end());
+        else CHECK(it != map.end() && it->second.v == i);
+        CHECK(map.find(100000 + i) == map.end());
+    }
+    LOG_PASS("dense_map Exception Safety");
+}
+
+int main() {
+    printf("Running fastmap::dense_map tests...\n\n");
+    test_basic_ops();
+    test_move_only_values();
+    test_string_keys();
+    test_against_reference();
+    test_exception_safety();
+    printf("\nAll dense_map tests passed successfully!\n");
+    return 0;
+}
@@ -7,6 +7,65 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define FM_HAVE_SSE2 1
+#endif
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+// AVX2 code paths are compiled with a per-function target and selected at
+// runtime, so the header needs no -mavx2 (unless it is already enabled).
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define FM_HAVE_AVX2 1
+    #define FM_TARGET_AVX2
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #include <immintrin.h>
+    #define FM_HAVE_AVX2 1
+    #define FM_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+    #define FM_HAVE_AVX2 1
+    #define FM_TARGET_AVX2
+#endif
+
+// The CRC32C (SSE4.2) and AES-NI hash backends follow the same scheme;
+// both need x86-64 for their 64-bit intrinsics.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <immintrin.h>
+    #define FM_HAVE_HW_HASH 1
+    #define FM_TARGET_SSE42 __attribute__((target("sse4.2")))
+    #define FM_TARGET_AES   __attribute__((target("sse4.2,aes")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+    #define FM_HAVE_HW_HASH 1
+    #define FM_TARGET_SSE42
+    #define FM_TARGET_AES
+#endif
+
+// Parallel index rebuilds (resize_threads > 1) run on pthreads unless the
+// map supplies its own parallel_for hook. Define FM_NO_PTHREADS to compile
+// the default out; the workers then run one after another.
+#if !defined(FM_NO_PTHREADS) && (defined(__unix__) || defined(__APPLE__))
+    #include <pthread.h>
+    #define FM_HAVE_PTHREADS 1
+#endif
+
+// Hot-path helpers that take their key/value sizes and key compare as
+// arguments are force-inlined, so constant arguments specialize them.
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define FM_FORCE_INLINE static __forceinline
+#else
+    #define FM_FORCE_INLINE static inline __attribute__((always_inline))
+#endif
+
+// Cold paths kept out of line, so they do not bloat every inlined caller
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define FM_NOINLINE static __declspec(noinline)
+#else
+    #define FM_NOINLINE static __attribute__((noinline))
+#endif
+
 // ============================================================================
 // SECTION 1: GENERIC HASHING (Wyhash & Type Selection)
 // ============================================================================
@@ -22,9 +81,170 @@ static inline uint64_t fm_wymix(uint64_t A, uint64_t B) {
 #endif
 }
 
+// ----------------------------------------------------------------------------
+// LONG KEYS (> FM_HASH_WIDE_MIN bytes)
+// 64-byte stripes feed 8 independent 64-bit accumulators (xxh3-style):
+//   dk = d[j] ^ key[j];  acc[j] += lo32(dk) * hi32(dk);  acc[j ^ 1] += d[j]
+// The per-stripe key advances by FM_STRIPE_STEP, so reordered stripes hash
+// differently. The tail is one more stripe over the last 64 bytes. Only
+// 32x32->64 multiplies are used, so the scalar, SSE2 and AVX2 versions
+// produce identical hashes and can be picked per machine.
+// ----------------------------------------------------------------------------
+#define FM_HASH_WIDE_MIN 64
+#define FM_STRIPE_LEN    64
+#define FM_STRIPE_STEP   0x9E3779B97F4A7C15ULL
+
+static const uint64_t FM_STRIPE_KEY[8] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+
+static inline uint64_t fm_read64(const uint8_t* p) {
+    uint64_t v; memcpy(&v, p, 8);
+    return v;
+}
+
+// Folds the accumulators into the final hash
+static inline uint64_t fm_stripe_fold(const uint64_t acc[8], size_t len) {
+    uint64_t h = (uint64_t)len * 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 8; i += 2) {
+        h += fm_wymix(acc[i] ^ FM_STRIPE_KEY[i + 1], acc[i + 1] ^ FM_STRIPE_KEY[i]);
+    }
+    return fm_wymix(h, 0xbf58476d1ce4e5b9ULL);
+}
+
+static inline void fm_stripe_scalar(uint64_t acc[8], const uint8_t* p, const uint64_t key[8]) {
+    for (int j = 0; j < 8; j += 2) {
+        uint64_t d0 = fm_read64(p + 8 * j);
+        uint64_t d1 = fm_read64(p + 8 * j + 8);
+        uint64_t k0 = d0 ^ key[j], k1 = d1 ^ key[j + 1];
+        acc[j] += (k0 & 0xFFFFFFFF) * (k0 >> 32) + d1;
+        acc[j + 1] += (k1 & 0xFFFFFFFF) * (k1 >> 32) + d0;
+    }
+}
+
+// Portable reference implementation
+static inline uint64_t fm_hash_wide_scalar(const uint8_t* p, size_t len) {
+    uint64_t acc[8], key[8];
+    for (int j = 0; j < 8; j++) {
+        acc[j] = FM_STRIPE_KEY[7 - j];
+        key[j] = FM_STRIPE_KEY[j];
+    }
+
+    size_t full = (len - 1) / FM_STRIPE_LEN;
+    for (size_t s = 0; s < full; s++) {
+        fm_stripe_scalar(acc, p + s * FM_STRIPE_LEN, key);
+        for (int j = 0; j < 8; j++) key[j] += FM_STRIPE_STEP;
+    }
+    fm_stripe_scalar(acc, p + len - FM_STRIPE_LEN, key);
+    return fm_stripe_fold(acc, len);
+}
+
+#if defined(FM_HAVE_SSE2)
+// One 16-byte half-stripe: 'acc' holds lanes j, j+1
+static inline __m128i fm_stripe_sse2(__m128i acc, const uint8_t* p, __m128i key) {
+    __m128i d = _mm_loadu_si128((const __m128i*)p);
+    __m128i dk = _mm_xor_si128(d, key);
+    __m128i prod = _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32));
+    __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)); // d[j ^ 1]
+    return _mm_add_epi64(acc, _mm_add_epi64(prod, swapped));
+}
+
+static inline uint64_t fm_hash_wide_sse2(const uint8_t* p, size_t len) {
+    __m128i acc[4], key[4];
+    const __m128i step = _mm_set1_epi64x((long long)FM_STRIPE_STEP);
+    for (int i = 0; i < 4; i++) {
+        acc[i] = _mm_set_epi64x((long long)FM_STRIPE_KEY[6 - 2 * i], (long long)FM_STRIPE_KEY[7 - 2 * i]);
+        key[i] = _mm_loadu_si128((const __m128i*)&FM_STRIPE_KEY[2 * i]);
+    }
+
+    size_t full = (len - 1) / FM_STRIPE_LEN;
+    for (size_t s = 0; s < full; s++) {
+        for (int i = 0; i < 4; i++) {
+            acc[i] = fm_stripe_sse2(acc[i], p + s * FM_STRIPE_LEN + 16 * i, key[i]);
+            key[i] = _mm_add_epi64(key[i], step);
+        }
+    }
+    for (int i = 0; i < 4; i++) acc[i] = fm_stripe_sse2(acc[i], p + len - FM_STRIPE_LEN + 16 * i, key[i]);
+
+    uint64_t out[8];
+    for (int i = 0; i < 4; i++) _mm_storeu_si128((__m128i*)&out[2 * i], acc[i]);
+    return fm_stripe_fold(out, len);
+}
+#endif
+
+#if defined(FM_HAVE_AVX2)
+FM_TARGET_AVX2 static inline __m256i fm_stripe_avx2(__m256i acc, const uint8_t* p, __m256i key) {
+    __m256i d = _mm256_loadu_si256((const __m256i*)p);
+    __m256i dk = _mm256_xor_si256(d, key);
+    __m256i prod = _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32));
+    __m256i swapped = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    return _mm256_add_epi64(acc, _mm256_add_epi64(prod, swapped));
+}
+
+FM_TARGET_AVX2 static inline uint64_t fm_hash_wide_avx2(const uint8_t* p, size_t len) {
+    const __m256i step = _mm256_set1_epi64x((long long)FM_STRIPE_STEP);
+    __m256i acc0 = _mm256_set_epi64x((long long)FM_STRIPE_KEY[4], (long long)FM_STRIPE_KEY[5],
+                                     (long long)FM_STRIPE_KEY[6], (long long)FM_STRIPE_KEY[7]);
+    __m256i acc1 = _mm256_set_epi64x((long long)FM_STRIPE_KEY[0], (long long)FM_STRIPE_KEY[1],
+                                     (long long)FM_STRIPE_KEY[2], (long long)FM_STRIPE_KEY[3]);
+    __m256i key0 = _mm256_loadu_si256((const __m256i*)&FM_STRIPE_KEY[0]);
+    __m256i key1 = _mm256_loadu_si256((const __m256i*)&FM_STRIPE_KEY[4]);
+
+    size_t full = (len - 1) / FM_STRIPE_LEN;
+    for (size_t s = 0; s < full; s++) {
+        acc0 = fm_stripe_avx2(acc0, p + s * FM_STRIPE_LEN, key0);
+        acc1 = fm_stripe_avx2(acc1, p + s * FM_STRIPE_LEN + 32, key1);
+        key0 = _mm256_add_epi64(key0, step);
+        key1 = _mm256_add_epi64(key1, step);
+    }
+    acc0 = fm_stripe_avx2(acc0, p + len - FM_STRIPE_LEN, key0);
+    acc1 = fm_stripe_avx2(acc1, p + len - FM_STRIPE_LEN + 32, key1);
+
+    uint64_t out[8];
+    _mm256_storeu_si256((__m256i*)&out[0], acc0);
+    _mm256_storeu_si256((__m256i*)&out[4], acc1);
+    return fm_stripe_fold(out, len);
+}
+
+static inline bool fm_cpu_has_avx2(void) {
+#if defined(__AVX2__)
+    return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    static volatile int cached = -1; // Benign race: every thread computes the same value
+    if (cached < 0) {
+        int info[4];
+        __cpuid(info, 1);
+        bool os_ymm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6); // OSXSAVE + YMM state
+        __cpuidex(info, 7, 0);
+        cached = os_ymm && (info[1] & (1 << 5));
+    }
+    return cached != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// Only keys over FM_HASH_WIDE_MIN bytes get here, so a call costs nothing
+// next to the hashing; inlined into fixed-size hashes it would bloat every
+// put and get.
+FM_NOINLINE uint64_t fm_hash_wide(const uint8_t* p, size_t len) {
+#if defined(FM_HAVE_AVX2)
+    if (fm_cpu_has_avx2()) return fm_hash_wide_avx2(p, len);
+#endif
+#if defined(FM_HAVE_SSE2)
+    return fm_hash_wide_sse2(p, len);
+#else
+    return fm_hash_wide_scalar(p, len);
+#endif
+}
+
 // The Universal Hash Function (Raw Bytes)
 static inline uint64_t fm_hash(const void* key, size_t len) {
     const uint8_t* p = (const uint8_t*)key;
+    if (len > FM_HASH_WIDE_MIN) return fm_hash_wide(p, len);
+
     uint64_t seed = 0x9E3779B97F4A7C15ULL;
     uint64_t see1 = len;
     while (len >= 8) {
@@ -48,6 +268,143 @@ static inline uint64_t fm_hash(const void* key, size_t len) {
     return fm_wymix(seed, see1);
 }
 
+// ----------------------------------------------------------------------------
+// HASH BACKENDS
+// A map hashes its fixed-size keys with the backend named by
+// fm_options.hash:
+//   FM_HASH_WY        fm_hash above (the default)
+//   FM_HASH_CRC32C    two SSE4.2 crc32 lanes and a multiply
+//   FM_HASH_AES       two AESENC rounds, halves folded (one round leaves bytes unmixed)
+//   FM_HASH_MULSHIFT  one multiply, high half folded down; fine for spread-out
+//                     integers, weak for keys differing only above bit 32
+//   FM_HASH_FAST      CRC32C if the CPU has it, else AES-NI, else WY
+// fm_init resolves the choice once against the CPU (a missing instruction
+// set falls back to FM_HASH_WY), so hashing is a switch on a per-map
+// constant. The alternatives only take keys of up to 16 bytes; longer keys
+// and string keys always use fm_hash.
+// ----------------------------------------------------------------------------
+typedef enum {
+    FM_HASH_WY = 0,
+    FM_HASH_CRC32C,
+    FM_HASH_AES,
+    FM_HASH_MULSHIFT,
+    FM_HASH_FAST,
+} fm_hash_kind;
+
+#define FM_HASH_SHORT_MAX 16
+
+// Zero-padded word from the last len < 8 bytes of a key
+static inline uint64_t fm_load_tail(const uint8_t* p, size_t len) {
+    if (len == 4) {
+        uint32_t v; memcpy(&v, p, 4);
+        return v;
+    }
+    uint64_t v = 0;
+    for (size_t j = 0; j < len; j++) v |= (uint64_t)p[j] << (8 * j);
+    return v;
+}
+
+// Zero-padded words of a key of up to 16 bytes. Full words are read in a
+// loop like fm_hash's, which keeps GCC's bounds checks quiet on short keys.
+static inline void fm_load_short(const uint8_t* p, size_t len, uint64_t* w0, uint64_t* w1) {
+    *w0 = *w1 = 0;
+    size_t words = 0;
+    for (; len >= 8; p += 8, len -= 8, words++) {
+        uint64_t v; memcpy(&v, p, 8);
+        if (words == 0) *w0 = v;
+        else *w1 = v;
+    }
+    if (len == 0) return;
+    if (words == 0) *w0 = fm_load_tail(p, len);
+    else *w1 = fm_load_tail(p, len);
+}
+
+static inline uint64_t fm_hash_mulshift(const uint8_t* p, size_t len) {
+    uint64_t w0, w1;
+    fm_load_short(p, len, &w0, &w1);
+    uint64_t h = (w0 ^ len) * 0x9E3779B97F4A7C15ULL;
+    if (len > 8) h = (h ^ w1) * 0xbf58476d1ce4e5b9ULL;
+    return h ^ (h >> 32);
+}
+
+#if defined(FM_HAVE_HW_HASH)
+// crc32 is linear and only 32 bits wide: the second lane sees the words
+// halves swapped, and the multiply carries both lanes into the top bits
+FM_TARGET_SSE42 static inline uint64_t fm_hash_crc32c(const uint8_t* p, size_t len) {
+    uint64_t w0, w1;
+    fm_load_short(p, len, &w0, &w1);
+    uint64_t a = _mm_crc32_u64(0xC2B2AE35u ^ len, w0);
+    uint64_t b = _mm_crc32_u64(0x27D4EB2Fu, (w0 >> 32) | (w0 << 32));
+    if (len > 8) {
+        a = _mm_crc32_u64(a, w1);
+        b = _mm_crc32_u64(b, (w1 >> 32) | (w1 << 32));
+    }
+    return ((b << 32) | a) * 0x9E3779B97F4A7C15ULL;
+}
+
+// One round mixes each byte into one column; the second spreads every
+// input byte over the whole block. Either half alone keeps structure from
+// keys that vary in few bytes, so both are folded.
+FM_TARGET_AES static inline uint64_t fm_hash_aes(const uint8_t* p, size_t len) {
+    uint64_t w0, w1;
+    fm_load_short(p, len, &w0, &w1);
+    const __m128i k0 = _mm_set_epi64x((long long)0xbf58476d1ce4e5b9ULL, (long long)(0x9E3779B97F4A7C15ULL ^ len));
+    const __m128i k1 = _mm_set_epi64x((long long)0x94d049bb133111ebULL, (long long)0x2545F4914F6CDD1DULL);
+    __m128i x = _mm_xor_si128(_mm_set_epi64x((long long)w1, (long long)w0), k0);
+    x = _mm_aesenc_si128(x, k1);
+    x = _mm_aesenc_si128(x, k0);
+    return (uint64_t)_mm_cvtsi128_si64(x) ^ (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(x, x));
+}
+
+static inline bool fm_cpu_has_sse42(void) {
+#if defined(__SSE4_2__)
+    return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static inline bool fm_cpu_has_aes(void) {
+#if defined(__AES__) && defined(__SSE4_2__)
+    return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 25)) && (info[2] & (1 << 20));
+#else
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("sse4.2");
+#endif
+}
+#endif
+
+// The backend 'kind' runs as on this CPU
+static inline fm_hash_kind fm_hash_resolve(fm_hash_kind kind) {
+    switch (kind) {
+#if defined(FM_HAVE_HW_HASH)
+        case FM_HASH_CRC32C:   return fm_cpu_has_sse42() ? FM_HASH_CRC32C : FM_HASH_WY;
+        case FM_HASH_AES:      return fm_cpu_has_aes() ? FM_HASH_AES : FM_HASH_WY;
+        case FM_HASH_FAST:     return fm_cpu_has_sse42() ? FM_HASH_CRC32C : fm_cpu_has_aes() ? FM_HASH_AES : FM_HASH_WY;
+#endif
+        case FM_HASH_MULSHIFT: return FM_HASH_MULSHIFT;
+        default:               return FM_HASH_WY;
+    }
+}
+
+// Hashes 'len' key bytes with a resolved backend
+FM_FORCE_INLINE uint64_t fm_hash_as(fm_hash_kind kind, const void* key, size_t len) {
+    if (kind == FM_HASH_WY || len > FM_HASH_SHORT_MAX) return fm_hash(key, len);
+    const uint8_t* p = (const uint8_t*)key;
+#if defined(FM_HAVE_HW_HASH)
+    if (kind == FM_HASH_CRC32C) return fm_hash_crc32c(p, len);
+    if (kind == FM_HASH_AES) return fm_hash_aes(p, len);
+#endif
+    return fm_hash_mulshift(p, len);
+}
+
 // --- Type-Generic Hash Helpers ---
 
 #define FM_MAKE_HASH_FN(type, suffix) \
@@ -106,112 +463,695 @@ static inline uint64_t fm_hash_double(double val) {
 // SECTION 2: INTERNAL DYNAMIC ARRAY (Type Erased)
 // ============================================================================
 
+// Memory hooks for everything a map allocates (see fm_options.allocator).
+// Every call receives 'ctx'. realloc_fn and free_fn are also told the
+// block's current size, which pool and arena allocators usually need.
+// alloc_fn / realloc_fn return NULL on failure, leaving the old block as is.
+typedef struct {
+    void* (*alloc_fn)(void* ctx, size_t size);
+    void* (*realloc_fn)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+    void (*free_fn)(void* ctx, void* ptr, size_t size);
+    void* ctx;
+} fm_allocator;
+
+// A NULL allocator means libc
+static inline void* fm_mem_alloc(const fm_allocator* a, size_t size) {
+    return a ? a->alloc_fn(a->ctx, size) : malloc(size);
+}
+
+static inline void* fm_mem_realloc(const fm_allocator* a, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return fm_mem_alloc(a, new_size);
+    return a ? a->realloc_fn(a->ctx, ptr, old_size, new_size) : realloc(ptr, new_size);
+}
+
+static inline void fm_mem_free(const fm_allocator* a, void* ptr, size_t size) {
+    if (!ptr) return;
+    if (a) a->free_fn(a->ctx, ptr, size);
+    else free(ptr);
+}
+
 typedef struct {
     unsigned char* data;
     size_t length;
     size_t capacity;
     size_t stride;
+    const fm_allocator* alloc; // NULL: libc
 } fm_vector;
 
-static inline void fm_vec_init(fm_vector* vec, size_t stride, size_t cap) {
-    vec->data = (unsigned char*)calloc(cap, stride); // calloc zeroes memory
+static inline void fm_vec_init(fm_vector* vec, size_t stride, size_t cap, const fm_allocator* alloc) {
+    vec->data = NULL;
+    if (cap > 0) {
+        vec->data = (unsigned char*)fm_mem_alloc(alloc, cap * stride);
+        if (!vec->data) abort(); // Handle OOM
+        memset(vec->data, 0, cap * stride);
+    }
     vec->length = 0;
     vec->capacity = cap;
     vec->stride = stride;
+    vec->alloc = alloc;
 }
 
-static inline void fm_vec_grow(fm_vector* vec) {
-    size_t new_cap = vec->capacity == 0 ? 8 : vec->capacity * 2;
-    unsigned char* new_data = (unsigned char*)realloc(vec->data, new_cap * vec->stride);
-    if (!new_data) abort(); // Handle OOM
+// Grows the buffer to hold at least 'cap' items (never shrinks); false,
+// with the vector unchanged, if the memory is not available
+static inline bool fm_vec_try_reserve(fm_vector* vec, size_t cap) {
+    if (cap <= vec->capacity) return true;
+    unsigned char* new_data = (unsigned char*)fm_mem_realloc(vec->alloc, vec->data, vec->capacity * vec->stride,
+                                                             cap * vec->stride);
+    if (!new_data) return false;
     vec->data = new_data;
-    vec->capacity = new_cap;
+    vec->capacity = cap;
+    return true;
 }
 
-static inline void fm_vec_push(fm_vector* vec, const void* item) {
+static inline void fm_vec_reserve(fm_vector* vec, size_t cap) {
+    if (!fm_vec_try_reserve(vec, cap)) abort(); // Handle OOM
+}
+
+static inline void fm_vec_grow(fm_vector* vec) {
+    fm_vec_reserve(vec, vec->capacity == 0 ? 8 : vec->capacity * 2);
+}
+
+// Room for 'extra' more items under the same doubling as fm_vec_grow, so
+// the pushes that follow never reallocate
+static inline bool fm_vec_try_make_room(fm_vector* vec, size_t extra) {
+    size_t cap = vec->capacity == 0 ? 8 : vec->capacity;
+    while (vec->length + extra > cap) cap *= 2;
+    return fm_vec_try_reserve(vec, cap);
+}
+
+// Push with the element size passed explicitly (a constant in typed maps)
+FM_FORCE_INLINE void fm_vec_push_n(fm_vector* vec, const void* item, size_t size) {
     if (vec->length >= vec->capacity) fm_vec_grow(vec);
-    memcpy(vec->data + (vec->length * vec->stride), item, vec->stride);
+    memcpy(vec->data + (vec->length * size), item, size);
     vec->length++;
 }
 
+static inline void fm_vec_push(fm_vector* vec, const void* item) {
+    fm_vec_push_n(vec, item, vec->stride);
+}
+
+// Appends 'count' contiguous items, growing as often as needed
+static inline void fm_vec_append(fm_vector* vec, const void* items, size_t count) {
+    while (vec->length + count > vec->capacity) fm_vec_grow(vec);
+    memcpy(vec->data + (vec->length * vec->stride), items, count * vec->stride);
+    vec->length += count;
+}
+
 static inline void* fm_vec_at(fm_vector* vec, size_t index) {
     return vec->data + (index * vec->stride);
 }
 
 static inline void fm_vec_free(fm_vector* vec) {
-    free(vec->data);
+    fm_mem_free(vec->alloc, vec->data, vec->capacity * vec->stride);
+    vec->capacity = 0;
     vec->data = NULL;
     vec->length = 0;
 }
 
 // ============================================================================
-// SECTION 3: THE DENSE MAP STRUCTURE
+// SECTION 3: CONTROL BYTES (SwissTable-style group probing)
+// ============================================================================
+
+// Each bucket can be shadowed by a 1-byte tag: the top 7 bits of its hash, or
+// FM_CTRL_EMPTY. A probe then scans 16 tags at a time and only touches 'keys'
+// on a tag match. Backshift deletion keeps the table free of tombstones, so
+// EMPTY is the only special state (and the only byte with its high bit set).
+#define FM_GROUP_WIDTH 16
+#define FM_CTRL_EMPTY  0x80
+
+static inline uint8_t fm_ctrl_tag(uint64_t hash) {
+    return (uint8_t)(hash >> 57); // Top bits: independent of the bucket mask
+}
+
+// The first FM_GROUP_WIDTH tags are mirrored past the end of the array so a
+// group load starting near the end wraps around without a branch.
+static inline void fm_ctrl_set(uint8_t* ctrl, size_t bucket_count, size_t i, uint8_t tag) {
+    ctrl[i] = tag;
+    if (i < FM_GROUP_WIDTH) ctrl[bucket_count + i] = tag;
+}
+
+static inline uint32_t fm_ctz32(uint32_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long r; _BitScanForward(&r, x); return (uint32_t)r;
+#else
+    return (uint32_t)__builtin_ctz(x);
+#endif
+}
+
+// Bitmask of the slots in the group whose tag equals 'tag'
+static inline uint32_t fm_group_match(const uint8_t* group, uint8_t tag) {
+#if defined(FM_HAVE_SSE2)
+    __m128i g = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)tag)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < FM_GROUP_WIDTH; i++) mask |= (uint32_t)(group[i] == tag) << i;
+    return mask;
+#endif
+}
+
+// Bitmask of the empty slots in the group
+static inline uint32_t fm_group_empty(const uint8_t* group) {
+#if defined(FM_HAVE_SSE2)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < FM_GROUP_WIDTH; i++) mask |= (uint32_t)(group[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+// ============================================================================
+// SECTION 4: THE DENSE MAP STRUCTURE
 // ============================================================================
 
-// Special index to mark a bucket as empty
-#define FM_EMPTY_IDX 0xFFFFFFFF
+// Position of an entry in the dense vectors, as stored in the index.
+// 32-bit by default; define FM_INDEX_64 (the same for every translation
+// unit) for maps beyond ~4 billion entries, at twice the bucket memory.
+// Packed slots then hold 40-bit indices and a 16-bit fingerprint.
+#if defined(FM_INDEX_64)
+typedef uint64_t fm_index;
+#define FM_EMPTY_IDX      UINT64_MAX
+#define FM_SLOT_IDX_BITS  40
+#else
+typedef uint32_t fm_index;
+#define FM_EMPTY_IDX      0xFFFFFFFF // Special index to mark a bucket as empty
+#define FM_SLOT_IDX_BITS  32
+#endif
+#define FM_SLOT_IDX_MASK  ((1ULL << FM_SLOT_IDX_BITS) - 1)
+
+// Skipped entry in the (home << 32 | vec_idx) items of the sorted rebuild
+// and bulk-build paths, which only run while both halves fit 32 bits
+#define FM_ITEM_SKIP 0xFFFFFFFFu
+
+// Returned by the internal bucket search when the key is absent
+#define FM_NPOS ((size_t)-1)
+
+// Packed bucket layout (FM_OPT_PACKED_BUCKETS): one uint64_t per bucket
+//   bits  0..31  vector index (0..39 with FM_INDEX_64)
+//   bits 32..55  24-bit hash fingerprint (40..55, 16-bit), top bits of the hash
+//   bits 56..63  probe distance + 1 (0 = empty slot)
+// Keeping the distance in the top byte makes "is the resident richer than
+// me?" a plain integer compare, and an all-zero slot sorts below everything.
+#define FM_SLOT_EMPTY     0ULL
+#define FM_SLOT_DIST_ONE  (1ULL << 56)
+#define FM_SLOT_DIST_MASK 0xFF00000000000000ULL
+#define FM_SLOT_MAX_DIST  254
+
+static inline uint64_t fm_slot_make(fm_index vec_idx, uint64_t hash, uint32_t dist) {
+    return ((uint64_t)(dist + 1) << 56) | ((hash >> (FM_SLOT_IDX_BITS + 8)) << FM_SLOT_IDX_BITS) | vec_idx;
+}
+
+static inline uint32_t fm_slot_dist(uint64_t slot) {
+    return (uint32_t)(slot >> 56) - 1;
+}
+
+// Option flags for fm_init_ex
+#define FM_OPT_CTRL_BYTES     (1u << 0) // Keep a control-byte array and probe with SIMD groups
+#define FM_OPT_PACKED_BUCKETS (1u << 1) // 64-bit buckets with fingerprint + distance (overrides CTRL_BYTES)
+#define FM_OPT_INCREMENTAL    (1u << 2) // Grow by migrating a few buckets per put/erase
+#define FM_OPT_STRING_KEYS    (1u << 3) // Keys are strings hashed by content (see fm_init_str)
+#define FM_OPT_FUSED          (1u << 4) // Index and dense vectors in one block (overrides INCREMENTAL)
+#define FM_OPT_SMALL          (1u << 5) // No index until FM_SMALL_MAX entries; lookups scan the hashes
+#define FM_OPT_COMPACT_INDEX  (1u << 6) // 8/16-bit plain buckets while the table is small enough
+#define FM_OPT_NO_HASH_CACHE  (1u << 7) // Recompute hashes from the keys instead of storing them
+
+// Runs fn(arg, 0) .. fn(arg, tasks - 1) to completion, possibly
+// concurrently. Lets a caller's thread pool serve parallel rebuilds.
+typedef void (*fm_task_fn)(void* arg, size_t task);
+typedef void (*fm_parallel_for_fn)(void* ctx, fm_task_fn fn, void* arg, size_t tasks);
+
+// Map options (opts may be NULL everywhere). Zero is the default for
+// every field, so name only what you set: { .flags = FM_OPT_CTRL_BYTES }
+// in C, or zero the struct and assign fields in C++. Settings that are not
+// on/off switches get a field here rather than flag bits or a setter.
+typedef struct {
+    uint32_t flags; // FM_OPT_* bits
+
+    // Multi-threaded index rebuilds for maps of at least
+    // FM_PARALLEL_REBUILD_MIN entries (resize_threads <= 1: off).
+    // 'parallel_for' may hand the workers to the caller's thread pool (it
+    // receives 'parallel_ctx'); NULL starts pthreads.
+    uint32_t resize_threads;
+    fm_parallel_for_fn parallel_for;
+    void* parallel_ctx;
+
+    // Source of all of the map's memory (NULL: libc); must outlive the map
+    const fm_allocator* allocator;
+
+    fm_hash_kind hash; // Backend for fixed-size keys (see HASH BACKENDS)
+} fm_options;
+
+// String key as stored in the dense 'keys' vector (FM_OPT_STRING_KEYS).
+// Up to FM_STR_INLINE_MAX bytes live in the record itself; longer strings
+// are copied into the map's append-only arena and referenced by offset
+// (not pointer, so the arena can move when it grows). The last byte is the
+// inline length in both layouts, or FM_STR_IN_ARENA.
+#define FM_STR_INLINE_MAX 15
+#define FM_STR_IN_ARENA   0xFF
+
+typedef union {
+    struct {
+        char bytes[FM_STR_INLINE_MAX];
+        uint8_t len;
+    } small;
+    struct {
+        uint64_t offset;
+        uint32_t len;
+        uint8_t pad[3];
+        uint8_t tag; // FM_STR_IN_ARENA
+    } big;
+} fm_str_key;
+
+// The Sparse Index (The "Buckets")
+// Exactly one of 'buckets' / 'slots' is allocated, depending on the layout.
+typedef struct {
+    fm_index* buckets;   // Indices into the dense vectors ('width' bytes each, see fm_bucket_load)
+    uint8_t* ctrl;       // Optional 7-bit hash tags per bucket (NULL = disabled)
+    uint64_t* slots;     // Packed buckets; replaces 'buckets' and 'ctrl' when set
+    size_t bucket_count; 
+    size_t bucket_mask;  // Optimization: size - 1 (for fast modulo)
+    const fm_allocator* alloc;
+    size_t width;        // Bytes per entry of 'buckets': sizeof(fm_index) unless compact
+} fm_table;
+
+// ----------------------------------------------------------------------------
+// COMPACT INDEX (FM_OPT_COMPACT_INDEX)
+// Plain buckets only need to count up to the table's load limit, which is
+// below its bucket count. A compact table stores them in 1 byte up to 256
+// buckets, 2 bytes up to 65536 and 4 bytes up to 2^32 (FM_INDEX_64 only);
+// all-ones is the empty marker at every width. Every resize picks the width
+// for the new bucket count, so a growing map widens its index on the way.
+// The ctrl and packed layouts keep their own formats.
+// ----------------------------------------------------------------------------
+
+static inline size_t fm_index_width(uint32_t flags, size_t bucket_count) {
+    if (!(flags & FM_OPT_COMPACT_INDEX) || (flags & (FM_OPT_CTRL_BYTES | FM_OPT_PACKED_BUCKETS))) {
+        return sizeof(fm_index);
+    }
+    if (bucket_count <= ((size_t)1 << 8)) return 1;
+    if (bucket_count <= ((size_t)1 << 16)) return 2;
+    if ((uint64_t)bucket_count <= ((uint64_t)1 << 32)) return 4;
+    return sizeof(fm_index);
+}
+
+// Bucket 'i' of a plain bucket array 'width' bytes per entry. Empty reads
+// back as FM_EMPTY_IDX at every width. Callers on hot paths pass a
+// constant width, so the switch folds away.
+FM_FORCE_INLINE fm_index fm_bucket_load(const fm_index* buckets, size_t i, size_t width) {
+    switch (width) {
+        case 1: {
+            uint8_t v = ((const uint8_t*)buckets)[i];
+            return v == UINT8_MAX ? FM_EMPTY_IDX : v;
+        }
+        case 2: {
+            uint16_t v = ((const uint16_t*)buckets)[i];
+            return v == UINT16_MAX ? FM_EMPTY_IDX : v;
+        }
+#if defined(FM_INDEX_64)
+        case 4: {
+            uint32_t v = ((const uint32_t*)buckets)[i];
+            return v == UINT32_MAX ? FM_EMPTY_IDX : v;
+        }
+#endif
+        default:
+            return buckets[i];
+    }
+}
+
+// Truncation turns FM_EMPTY_IDX into the narrow empty marker
+FM_FORCE_INLINE void fm_bucket_store(fm_index* buckets, size_t i, fm_index v, size_t width) {
+    switch (width) {
+        case 1: ((uint8_t*)buckets)[i] = (uint8_t)v; break;
+        case 2: ((uint16_t*)buckets)[i] = (uint16_t)v; break;
+#if defined(FM_INDEX_64)
+        case 4: ((uint32_t*)buckets)[i] = (uint32_t)v; break;
+#endif
+        default: buckets[i] = v; break;
+    }
+}
+
+// Operation counters, maintained only when FM_ENABLE_COUNTERS is defined
+// (define it for every translation unit that touches the map). The field is
+// always present so the struct layout does not depend on the option.
+typedef struct {
+    uint64_t lookups;      // Key searches (get, and the existence check in put / erase)
+    uint64_t probes;       // Buckets visited (16-wide groups with FM_OPT_CTRL_BYTES)
+    uint64_t key_compares; // Calls to the key compare
+    uint64_t early_exits;  // Misses cut short by the Robin Hood distance check
+    uint64_t inserts;
+    uint64_t erases;
+    uint64_t resizes;      // Blocking rebuilds plus incremental migrations started
+} fm_counters;
+
+#if defined(FM_ENABLE_COUNTERS)
+    #define FM_COUNT(map, field) ((map)->counters.field++)
+    #define FM_COUNT_N(map, field, n) ((map)->counters.field += (n))
+#else
+    #define FM_COUNT(map, field) ((void)0)
+    #define FM_COUNT_N(map, field, n) ((void)0)
+#endif
 
 typedef struct {
     // The Dense Storage
     fm_vector keys;    // User's Keys
     fm_vector values;  // User's Values
-    fm_vector hashes;  // Cached uint64_t hashes (avoids re-hashing on resize)
-
-    // The Sparse Index (The "Buckets")
-    // This array stores indices into the vectors above.
-    uint32_t* buckets; 
-    size_t bucket_count; 
-    size_t bucket_mask;  // Optimization: size - 1 (for fast modulo)
+    fm_vector hashes;  // Cached uint64_t hashes (avoids re-hashing on resize); empty with FM_OPT_NO_HASH_CACHE
+    fm_vector arena;   // String bytes for FM_OPT_STRING_KEYS (append-only)
+
+    // This table stores indices into the vectors above.
+    fm_table table;
+
+    // Incremental resize: while 'old_table.bucket_count' is non-zero, the
+    // previous table still owns the entries in its last 'migrate_left' slots
+    // (cyclically from 'migrate_pos'). New entries always go to 'table'.
+    fm_table old_table;
+    size_t migrate_pos;
+    size_t migrate_left;
     
     // Metadata
     size_t key_size;
     size_t val_size;
     float max_load_factor; // e.g., 0.75
+    uint32_t flags;        // FM_OPT_* bits the map was created with
+    fm_hash_kind hash_kind; // Resolved backend (see fm_hash_resolve)
+    const fm_allocator* allocator; // NULL: libc (see fm_options)
+
+    // Parallel rebuild, see fm_options
+    uint32_t resize_threads;
+    fm_parallel_for_fn parallel_for;
+    void* parallel_ctx;
+
+    fm_counters counters;  // See FM_ENABLE_COUNTERS
 } _FastMap;
 
-// Initialize the map
-static inline _FastMap fm_init(size_t key_size, size_t val_size) {
+// ----------------------------------------------------------------------------
+// HASH CACHE (FM_OPT_NO_HASH_CACHE)
+// By default every entry's hash is stored next to it, so resizes, Robin
+// Hood swaps and backshifts never rehash a key. For small fixed-size keys
+// hashing the key again is a few multiplies, cheaper than 8 more bytes of
+// memory traffic per entry; FM_OPT_NO_HASH_CACHE drops the 'hashes' vector
+// and fm_hash_at recomputes from 'keys'. It is ignored for string keys and
+// for the fused and small layouts, whose blocks and scans are built around
+// the cached hashes, and by FM_DECLARE maps, which hash with their own
+// function.
+// ----------------------------------------------------------------------------
+
+static inline bool fm_caches_hashes(const _FastMap* map) {
+    return !(map->flags & FM_OPT_NO_HASH_CACHE);
+}
+
+// Hash of a fixed-size key with the map's backend
+FM_FORCE_INLINE uint64_t fm_map_hash(const _FastMap* map, const void* key) {
+    return fm_hash_as(map->hash_kind, key, map->key_size);
+}
+
+// Hash of the entry at vector index 'idx'
+FM_FORCE_INLINE uint64_t fm_hash_at(const _FastMap* map, size_t idx) {
+    if (fm_caches_hashes(map)) return ((const uint64_t*)map->hashes.data)[idx];
+    const unsigned char* key = map->keys.data + idx * map->key_size;
+    switch (map->key_size) { // Constant sizes let fm_hash unroll
+        case 4:  return fm_hash_as(map->hash_kind, key, 4);
+        case 8:  return fm_hash_as(map->hash_kind, key, 8);
+        default: return fm_map_hash(map, key);
+    }
+}
+
+// Key equality used by the probe loops: 'stored' points into the keys vector
+typedef bool (*fm_key_eq_fn)(const _FastMap* map, const void* stored, const void* probe);
+
+// Default equality: raw bytes, as hashed by fm_hash. The common key sizes
+// compare as word loads instead of a memcmp call; the switch is on a
+// per-map constant, so it predicts perfectly inside a probe loop. 16-byte
+// keys go through a constant-size memcmp, which compilers expand inline.
+// Inlined next to a caller's 4- or 8-byte key, GCC checks the wider cases
+// against that key's size even though key_size rules them out; the
+// diagnostics are silenced for this function only.
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Warray-bounds"
+    #if __GNUC__ >= 11
+        #pragma GCC diagnostic ignored "-Wstringop-overread"
+    #endif
+#endif
+static inline bool fm_key_eq_bytes(const _FastMap* map, const void* stored, const void* probe) {
+    switch (map->key_size) {
+        case 4: {
+            uint32_t a, b;
+            memcpy(&a, stored, 4); memcpy(&b, probe, 4);
+            return a == b;
+        }
+        case 8: {
+            uint64_t a, b;
+            memcpy(&a, stored, 8); memcpy(&b, probe, 8);
+            return a == b;
+        }
+        case 16:
+            return memcmp(stored, probe, 16) == 0;
+        default:
+            return memcmp(stored, probe, map->key_size) == 0;
+    }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic pop
+#endif
+
+// Resets every bucket of 't' to empty
+static inline void fm_table_clear(fm_table* t) {
+    if (t->slots) memset(t->slots, 0, t->bucket_count * sizeof(uint64_t)); // FM_SLOT_EMPTY
+    if (t->buckets) memset(t->buckets, 0xFF, t->bucket_count * t->width); // Set to -1
+    if (t->ctrl) memset(t->ctrl, FM_CTRL_EMPTY, t->bucket_count + FM_GROUP_WIDTH);
+}
+
+static inline void fm_table_free(fm_table* t) {
+    fm_mem_free(t->alloc, t->buckets, t->bucket_count * t->width);
+    fm_mem_free(t->alloc, t->ctrl, t->bucket_count + FM_GROUP_WIDTH);
+    fm_mem_free(t->alloc, t->slots, t->bucket_count * sizeof(uint64_t));
+    memset(t, 0, sizeof(*t));
+}
+
+// Allocates an empty table in the layout selected by 'flags'; false if
+// the memory is not available
+static inline bool fm_table_try_alloc(fm_table* t, size_t bucket_count, uint32_t flags, const fm_allocator* alloc) {
+    t->buckets = NULL;
+    t->ctrl = NULL;
+    t->slots = NULL;
+    t->bucket_count = bucket_count;
+    t->bucket_mask = bucket_count - 1;
+    t->alloc = alloc;
+    t->width = fm_index_width(flags, bucket_count);
+
+    if (flags & FM_OPT_PACKED_BUCKETS) {
+        t->slots = (uint64_t*)fm_mem_alloc(alloc, bucket_count * sizeof(uint64_t));
+        if (!t->slots) return false;
+    } else {
+        t->buckets = (fm_index*)fm_mem_alloc(alloc, bucket_count * t->width);
+        if (flags & FM_OPT_CTRL_BYTES) t->ctrl = (uint8_t*)fm_mem_alloc(alloc, bucket_count + FM_GROUP_WIDTH);
+        if (!t->buckets || ((flags & FM_OPT_CTRL_BYTES) && !t->ctrl)) {
+            fm_table_free(t);
+            return false;
+        }
+    }
+    fm_table_clear(t);
+    return true;
+}
+
+static inline fm_table fm_table_alloc(size_t bucket_count, uint32_t flags, const fm_allocator* alloc) {
+    fm_table t;
+    if (!fm_table_try_alloc(&t, bucket_count, flags, alloc)) abort(); // Handle OOM
+    return t;
+}
+
+// ----------------------------------------------------------------------------
+// FUSED STORAGE (FM_OPT_FUSED)
+// One allocation holds everything but the string arena, each region at a
+// 16-byte boundary:
+//   hashes[cap] | buckets or slots[bucket_count] | ctrl | keys[cap] | values[cap]
+// cap is the table's load limit (bucket_count * max_load_factor), so the
+// vectors fill exactly when the index is due to grow, and both grow in one
+// step: a new block, one copy per region, an index rebuild. The block
+// starts with the hashes, so hashes.data is the pointer to free. Growth is
+// always blocking; FM_OPT_INCREMENTAL is ignored. Each growth is a single
+// allocator call instead of up to four, at the price of spare capacity up
+// to the load limit right after it (see 'bench fused').
+// ----------------------------------------------------------------------------
+#define FM_FUSED_ALIGN 16
+
+typedef struct {
+    size_t cap;    // Entries the vectors hold
+    size_t index;  // Region offsets in the block
+    size_t ctrl;
+    size_t keys;
+    size_t values;
+    size_t bytes;  // Block size
+} fm_fused_layout;
+
+static inline size_t fm_fused_align(size_t n) {
+    return (n + FM_FUSED_ALIGN - 1) & ~(size_t)(FM_FUSED_ALIGN - 1);
+}
+
+static inline fm_fused_layout fm_fused_plan(const _FastMap* map, size_t bucket_count, size_t cap) {
+    bool packed = map->flags & FM_OPT_PACKED_BUCKETS;
+    bool ctrl = (map->flags & FM_OPT_CTRL_BYTES) && !packed && bucket_count > 0;
+    fm_fused_layout l;
+    l.cap = cap;
+    l.index = fm_fused_align(cap * sizeof(uint64_t));
+    l.ctrl = fm_fused_align(l.index + bucket_count * (packed ? sizeof(uint64_t) : fm_index_width(map->flags, bucket_count)));
+    l.keys = fm_fused_align(l.ctrl + (ctrl ? bucket_count + FM_GROUP_WIDTH : 0));
+    l.values = fm_fused_align(l.keys + cap * map->key_size);
+    l.bytes = l.values + cap * map->val_size;
+    return l;
+}
+
+// Bytes of the map's current block
+static inline size_t fm_fused_bytes(const _FastMap* map) {
+    return fm_fused_plan(map, map->table.bucket_count, map->keys.capacity).bytes;
+}
+
+// An empty index living in the block's index region
+static inline fm_table fm_fused_table(const _FastMap* map, unsigned char* block, const fm_fused_layout* l,
+                                      size_t bucket_count) {
+    fm_table t;
+    memset(&t, 0, sizeof(t));
+    t.bucket_count = bucket_count;
+    t.bucket_mask = bucket_count - 1;
+    t.width = fm_index_width(map->flags, bucket_count);
+    if (map->flags & FM_OPT_PACKED_BUCKETS) {
+        t.slots = (uint64_t*)(block + l->index);
+    } else {
+        t.buckets = (fm_index*)(block + l->index);
+        if (map->flags & FM_OPT_CTRL_BYTES) t.ctrl = block + l->ctrl;
+    }
+    fm_table_clear(&t);
+    return t;
+}
+
+// Makes 'block' the map's storage (the entries must already be in it)
+static inline void fm_fused_install(_FastMap* map, unsigned char* block, const fm_fused_layout* l, const fm_table* t) {
+    map->hashes.data = block;
+    map->keys.data = block + l->keys;
+    map->values.data = block + l->values;
+    map->hashes.capacity = map->keys.capacity = map->values.capacity = l->cap;
+    map->table = *t;
+}
+
+// ----------------------------------------------------------------------------
+// SMALL MAPS (FM_OPT_SMALL)
+// A small map has no index (table.bucket_count == 0). fm_init allocates
+// nothing; the first insert allocates one fused block with room for
+// FM_SMALL_MAX entries and no index regions, and lookups compare the probe
+// hash against every cached hash at once (fm_small_match). The insert past
+// FM_SMALL_MAX builds a 16-bucket index and moves the entries into the
+// map's regular layout; the map never goes back to small.
+// ----------------------------------------------------------------------------
+#define FM_SMALL_MAX 8 // Even, at most 32 (one match bit per entry)
+
+static inline bool fm_small_try_alloc(_FastMap* map) {
+    fm_fused_layout l = fm_fused_plan(map, 0, FM_SMALL_MAX);
+    unsigned char* block = (unsigned char*)fm_mem_alloc(map->allocator, l.bytes);
+    if (!block) return false;
+    memset(block, 0, FM_SMALL_MAX * sizeof(uint64_t)); // The scan reads every hash slot
+    fm_table none;
+    memset(&none, 0, sizeof(none));
+    fm_fused_install(map, block, &l, &none);
+    return true;
+}
+
+// Initialize the map with options (opts may be NULL)
+static inline _FastMap fm_init_ex(size_t key_size, size_t val_size, const fm_options* opts) {
+    const fm_allocator* allocator = opts ? opts->allocator : NULL;
     _FastMap map;
+    map.flags = opts ? opts->flags : 0;
+    if (map.flags & FM_OPT_FUSED) map.flags &= ~FM_OPT_INCREMENTAL;
+    if (map.flags & (FM_OPT_STRING_KEYS | FM_OPT_FUSED | FM_OPT_SMALL)) map.flags &= ~FM_OPT_NO_HASH_CACHE;
+    if (map.flags & FM_OPT_STRING_KEYS) key_size = sizeof(fm_str_key);
+    map.hash_kind = (opts && !(map.flags & FM_OPT_STRING_KEYS)) ? fm_hash_resolve(opts->hash) : FM_HASH_WY;
     map.key_size = key_size;
     map.val_size = val_size;
     map.max_load_factor = 0.80f; // Dense maps can handle high load
-    map.bucket_count = 16;       // Power of 2 start
-    map.bucket_mask = 15;
-    
-    // Alloc buckets (init to EMPTY)
-    map.buckets = (uint32_t*)malloc(map.bucket_count * sizeof(uint32_t));
-    memset(map.buckets, 0xFF, map.bucket_count * sizeof(uint32_t)); // Set to -1
+    map.allocator = allocator;
+    map.resize_threads = opts ? opts->resize_threads : 0;
+    map.parallel_for = opts ? opts->parallel_for : NULL;
+    map.parallel_ctx = opts ? opts->parallel_ctx : NULL;
+
+    memset(&map.old_table, 0, sizeof(map.old_table));
+    map.migrate_pos = 0;
+    map.migrate_left = 0;
+    memset(&map.counters, 0, sizeof(map.counters));
+    fm_vec_init(&map.arena, 1, 0, allocator);
+
+    if (map.flags & FM_OPT_SMALL) { // Nothing allocated until the first insert
+        memset(&map.table, 0, sizeof(map.table));
+        fm_vec_init(&map.keys, key_size, 0, allocator);
+        fm_vec_init(&map.values, val_size, 0, allocator);
+        fm_vec_init(&map.hashes, sizeof(uint64_t), 0, allocator);
+        return map;
+    }
+
+    if (map.flags & FM_OPT_FUSED) {
+        fm_vec_init(&map.keys, key_size, 0, allocator);
+        fm_vec_init(&map.values, val_size, 0, allocator);
+        fm_vec_init(&map.hashes, sizeof(uint64_t), 0, allocator);
+        size_t buckets = 16;
+        fm_fused_layout l = fm_fused_plan(&map, buckets, (size_t)((float)buckets * map.max_load_factor));
+        unsigned char* block = (unsigned char*)fm_mem_alloc(allocator, l.bytes);
+        if (!block) abort(); // Handle OOM
+        fm_table t = fm_fused_table(&map, block, &l, buckets);
+        fm_fused_install(&map, block, &l, &t);
+        return map;
+    }
+
+    map.table = fm_table_alloc(16, map.flags, allocator); // Power of 2 start
 
     // Init vectors
-    fm_vec_init(&map.keys, key_size, 8);
-    fm_vec_init(&map.values, val_size, 8);
-    fm_vec_init(&map.hashes, sizeof(uint64_t), 8);
+    fm_vec_init(&map.keys, key_size, 8, allocator);
+    fm_vec_init(&map.values, val_size, 8, allocator);
+    fm_vec_init(&map.hashes, sizeof(uint64_t), fm_caches_hashes(&map) ? 8 : 0, allocator);
 
     return map;
 }
 
+// Initialize the map
+static inline _FastMap fm_init(size_t key_size, size_t val_size) {
+    return fm_init_ex(key_size, val_size, NULL);
+}
+
 static inline void fm_free(_FastMap* map) {
+    if ((map->flags & FM_OPT_FUSED) || map->table.bucket_count == 0) { // Fused or still small
+        fm_mem_free(map->allocator, map->hashes.data, fm_fused_bytes(map));
+        fm_vec_free(&map->arena);
+        map->hashes.data = map->keys.data = map->values.data = NULL;
+        map->hashes.capacity = map->keys.capacity = map->values.capacity = 0;
+        map->keys.length = map->values.length = map->hashes.length = 0;
+        memset(&map->table, 0, sizeof(map->table));
+        return;
+    }
     fm_vec_free(&map->keys);
     fm_vec_free(&map->values);
     fm_vec_free(&map->hashes);
-    free(map->buckets);
+    fm_vec_free(&map->arena);
+    fm_table_free(&map->table);
+    fm_table_free(&map->old_table);
 }
 
 // ============================================================================
-// SECTION 4: INTERNAL LOGIC (Resize & Robin Hood)
+// SECTION 5: INTERNAL LOGIC (Resize & Robin Hood)
 // ============================================================================
 
 // Place an index into the bucket array using Robin Hood Hashing
-static inline void fm_place_index(uint32_t* buckets, size_t mask, uint64_t hash, uint32_t vec_idx, const fm_vector* hashes_vec) {
+// 'ctrl' may be NULL; when present, each tag travels with the index it shadows.
+static inline void fm_place_index(fm_index* buckets, size_t width, uint8_t* ctrl, size_t mask, uint64_t hash, fm_index vec_idx, const _FastMap* map) {
     size_t bucket_idx = hash & mask;
     uint32_t dist = 0;
+    uint8_t tag = fm_ctrl_tag(hash);
 
     while (true) {
-        uint32_t existing_idx = buckets[bucket_idx];
+        fm_index existing_idx = fm_bucket_load(buckets, bucket_idx, width);
 
         // Case 1: Empty Slot - Found our home!
         if (existing_idx == FM_EMPTY_IDX) {
-            buckets[bucket_idx] = vec_idx;
+            fm_bucket_store(buckets, bucket_idx, vec_idx, width);
+            if (ctrl) fm_ctrl_set(ctrl, mask + 1, bucket_idx, tag);
             return;
         }
 
@@ -219,7 +1159,7 @@ static inline void fm_place_index(uint32_t* buckets, size_t mask, uint64_t hash,
         // We need to check if the existing item is "richer" (closer to home) than us.
         
         // Retrieve the hash of the item currently sitting here
-        uint64_t existing_hash = *(uint64_t*)fm_vec_at((fm_vector*)hashes_vec, existing_idx);
+        uint64_t existing_hash = fm_hash_at(map, existing_idx);
         
         // Calculate its current distance from its ideal home
         size_t ideal_idx = existing_hash & mask;
@@ -229,9 +1169,12 @@ static inline void fm_place_index(uint32_t* buckets, size_t mask, uint64_t hash,
         if (existing_dist < dist) {
             // SWAP! We are poorer (further away), so we steal this spot.
             // The existing guy gets evicted and has to find a new spot.
-            uint32_t temp = buckets[bucket_idx];
-            buckets[bucket_idx] = vec_idx;
-            vec_idx = temp;
+            fm_bucket_store(buckets, bucket_idx, vec_idx, width);
+            vec_idx = existing_idx;
+            if (ctrl) {
+                fm_ctrl_set(ctrl, mask + 1, bucket_idx, tag);
+                tag = fm_ctrl_tag(existing_hash);
+            }
             
             dist = existing_dist; // Update distance for the evicted item
         }
@@ -242,229 +1185,1502 @@ static inline void fm_place_index(uint32_t* buckets, size_t mask, uint64_t hash,
     }
 }
 
-static inline void fm_resize(_FastMap* map, size_t new_capacity) {
-    uint32_t* new_buckets = (uint32_t*)malloc(new_capacity * sizeof(uint32_t));
-    memset(new_buckets, 0xFF, new_capacity * sizeof(uint32_t)); // Set to -1
-    
-    size_t new_mask = new_capacity - 1;
-    
-    // Re-insert every existing item into the new bucket array
-    for (size_t i = 0; i < map->keys.length; i++) {
-        uint64_t h = *(uint64_t*)fm_vec_at(&map->hashes, i);
-        fm_place_index(new_buckets, new_mask, h, (uint32_t)i, &map->hashes);
-    }
-
-    free(map->buckets);
-    map->buckets = new_buckets;
-    map->bucket_count = new_capacity;
-    map->bucket_mask = new_mask;
-}
-
-// ============================================================================
-// SECTION 5: PUBLIC API (Put / Get / Delete)
-// ============================================================================
-
-// Insert or Update
-static inline void fm_put(_FastMap* map, const void* key, const void* value) {
-    // 1. Check Load Factor
-    if (map->keys.length >= map->bucket_count * map->max_load_factor) {
-        fm_resize(map, map->bucket_count * 2);
-    }
-
-    uint64_t hash = fm_hash(key, map->key_size);
-    size_t bucket_idx = hash & map->bucket_mask;
-    size_t dist = 0;
+// Packed layout: the same Robin Hood placement, but the distance of the
+// resident entry is read from its slot instead of from the hashes vector.
+// Returns false if a distance would overflow FM_SLOT_MAX_DIST; the caller
+// must then rebuild with more buckets (the dense vectors remain the source
+// of truth, so the entry left in hand is not lost).
+static inline bool fm_place_slot(uint64_t* slots, size_t mask, uint64_t hash, fm_index vec_idx) {
+    size_t bucket_idx = hash & mask;
+    uint64_t entry = fm_slot_make(vec_idx, hash, 0);
 
-    // 2. Probe to see if key exists
     while (true) {
-        uint32_t idx = map->buckets[bucket_idx];
-
-        // Stop if empty (Key doesn't exist, insert new)
-        if (idx == FM_EMPTY_IDX) break;
+        uint64_t existing = slots[bucket_idx];
 
-        // Robin Hood Optimization: Early Exit on Miss
-        uint64_t existing_hash = *(uint64_t*)fm_vec_at(&map->hashes, idx);
-        size_t ideal_idx = existing_hash & map->bucket_mask;
-        uint32_t existing_dist = (bucket_idx + map->bucket_mask + 1 - ideal_idx) & map->bucket_mask;
-        if (existing_dist < dist) break; // We can stop probing
+        if (existing == FM_SLOT_EMPTY) {
+            slots[bucket_idx] = entry;
+            return true;
+        }
 
-        // Check for Match
-        void* existing_key = fm_vec_at(&map->keys, idx);
-        if (memcmp(existing_key, key, map->key_size) == 0) {
-            // Update Value
-            void* val_ptr = fm_vec_at(&map->values, idx);
-            memcpy(val_ptr, value, map->val_size);
-            return; 
+        // Distance lives in the top byte, so richer residents compare lower
+        if (existing < (entry & FM_SLOT_DIST_MASK)) {
+            slots[bucket_idx] = entry;
+            entry = existing;
         }
 
-        bucket_idx = (bucket_idx + 1) & map->bucket_mask;
-        dist++;
+        if (fm_slot_dist(entry) == FM_SLOT_MAX_DIST) return false;
+        entry += FM_SLOT_DIST_ONE;
+        bucket_idx = (bucket_idx + 1) & mask;
     }
+}
 
-    // 3. Insert New (Append to dense vectors)
-    uint32_t new_idx = (uint32_t)map->keys.length;
-    fm_vec_push(&map->keys, key);
-    fm_vec_push(&map->values, value);
-    fm_vec_push(&map->hashes, &hash); // Cache the hash!
+// Places one entry into 't'; false means the packed layout overflowed
+static inline bool fm_table_place(_FastMap* map, fm_table* t, uint64_t hash, fm_index vec_idx) {
+    if (t->slots) return fm_place_slot(t->slots, t->bucket_mask, hash, vec_idx);
+    fm_place_index(t->buckets, t->width, t->ctrl, t->bucket_mask, hash, vec_idx, map);
+    return true;
+}
 
-    // 4. Place index into buckets (Robin Hood logic handles the rest)
-    fm_place_index(map->buckets, map->bucket_mask, hash, new_idx, &map->hashes);
+// Places entries given as (home << 32 | vec_idx), sorted by home bucket,
+// front to back from bucket '*next'. Linear probing in home order already
+// is the Robin Hood layout, so nothing is displaced and every write lands
+// just after the previous one. Stops at the first entry that would land at
+// or past 'end' and returns how many items it consumed: from there on every
+// entry would, so the caller places the rest with fm_place_items.
+// FM_ITEM_SKIP entries are skipped. 'item_hashes' optionally runs parallel
+// to 'items' so tagged layouts need not look hashes up by index. Returns
+// FM_NPOS if a packed distance would overflow.
+static inline size_t fm_fill_sorted(_FastMap* map, fm_table* t, const uint64_t* items,
+                                    const uint64_t* item_hashes, size_t n, size_t* next, size_t end) {
+    size_t pos_next = *next;
+    size_t i = 0;
+    for (; i < n; i++) {
+        uint32_t idx = (uint32_t)items[i];
+        if (idx == FM_ITEM_SKIP) continue;
+        size_t home = (size_t)(items[i] >> 32);
+        size_t pos = home > pos_next ? home : pos_next;
+        if (pos >= end) break;
+
+        if (t->slots) {
+            if (pos - home > FM_SLOT_MAX_DIST) return FM_NPOS;
+            uint64_t hash = item_hashes ? item_hashes[i] : fm_hash_at(map, idx);
+            t->slots[pos] = fm_slot_make(idx, hash, (uint32_t)(pos - home));
+        } else {
+            // Plain buckets need nothing but the index: no hash reads at all
+            fm_bucket_store(t->buckets, pos, idx, t->width);
+            if (t->ctrl) {
+                uint64_t hash = item_hashes ? item_hashes[i] : fm_hash_at(map, idx);
+                fm_ctrl_set(t->ctrl, t->bucket_count, pos, fm_ctrl_tag(hash));
+            }
+        }
+        pos_next = pos + 1;
+    }
+    *next = pos_next;
+    return i;
 }
 
-// Get Value
-static inline void* fm_get(_FastMap* map, const void* key) {
-    uint64_t hash = fm_hash(key, map->key_size);
-    size_t bucket_idx = hash & map->bucket_mask;
-    size_t dist = 0; // Track our distance for early exit
+// Regular Robin Hood placement of (home << 32 | vec_idx) items, skipping
+// FM_ITEM_SKIP. Returns false if a packed distance would overflow.
+static inline bool fm_place_items(_FastMap* map, fm_table* t, const uint64_t* items, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t idx = (uint32_t)items[i];
+        if (idx == FM_ITEM_SKIP) continue;
+        if (!fm_table_place(map, t, fm_hash_at(map, idx), idx)) return false;
+    }
+    return true;
+}
+
+// True if 'n' entries homed in 'bucket_count' buckets fit the 32-bit halves
+// of an item. Always the case without FM_INDEX_64 (see fm_index_fits).
+static inline bool fm_items_fit(size_t n, size_t bucket_count) {
+    return (uint64_t)n < FM_ITEM_SKIP && (uint64_t)bucket_count <= ((uint64_t)1 << 32);
+}
+
+// Rebuild in dense order: one Robin Hood insert per entry. Every insert
+// writes a random bucket and every swap reads a random cached hash.
+static inline bool fm_rebuild_dense(_FastMap* map, fm_table* t) {
+    for (size_t i = 0; i < map->keys.length; i++) {
+        if (!fm_table_place(map, t, fm_hash_at(map, i), (fm_index)i)) return false;
+    }
+    return true;
+}
+
+#ifdef FM_HAVE_PTHREADS
+typedef struct {
+    fm_task_fn fn;
+    void* arg;
+    size_t task;
+} fm_thread_arg;
+
+static inline void* fm_thread_main(void* p) {
+    fm_thread_arg* a = (fm_thread_arg*)p;
+    a->fn(a->arg, a->task);
+    return NULL;
+}
+#endif
+
+// Default parallel_for: one thread per task, task 0 on the calling thread.
+// If a thread cannot be started (or tracked) its task simply runs inline.
+static inline void fm_parallel_for_default(void* ctx, fm_task_fn fn, void* arg, size_t tasks) {
+    (void)ctx;
+#ifdef FM_HAVE_PTHREADS
+    if (tasks > 1) {
+        pthread_t* ids = (pthread_t*)malloc((tasks - 1) * sizeof(pthread_t));
+        fm_thread_arg* args = (fm_thread_arg*)malloc((tasks - 1) * sizeof(fm_thread_arg));
+        size_t started = 0;
+        while (ids && args && started < tasks - 1) {
+            fm_thread_arg a = { fn, arg, started + 1 };
+            args[started] = a;
+            if (pthread_create(&ids[started], NULL, fm_thread_main, &args[started]) != 0) break;
+            started++;
+        }
+        fn(arg, 0);
+        for (size_t i = started + 1; i < tasks; i++) fn(arg, i);
+        for (size_t i = 0; i < started; i++) pthread_join(ids[i], NULL);
+        free(ids);
+        free(args);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < tasks; i++) fn(arg, i);
+}
+
+// Rebuild in bucket order. Pass 1 streams the cached hashes once and
+// partitions (home << 32 | vec_idx) by the top bits of the home (a counting
+// sort into windows of the bucket array). Pass 2 takes one window at a time,
+// sorts its entries by exact home with a small in-cache counting sort and
+// fills the window with fm_fill_sorted, so the bucket writes form a
+// sequential sweep over the new table. Tagged layouts (ctrl bytes, packed
+// slots) carry each hash alongside its item so the sweep never reads the
+// dense hash vector at random.
+//
+// With map->resize_threads > 1 both passes split across workers: pass 1 by
+// slices of the dense vectors (per-worker histograms, then a scatter into
+// disjoint ranges), pass 2 by contiguous regions of windows. A region's
+// sweep stops at its last bucket; what would run past it is always a
+// suffix of that region's entries and gets the regular Robin Hood insert
+// once all workers are done. The final wrap-around is handled the same way.
+//
+// Scratch memory comes from the map's allocator. If it runs out, the table
+// is cleared and rebuilt in dense order, which needs none.
+#define FM_REBUILD_WINDOW_BITS  12        // Buckets per window (minimum)
+#define FM_REBUILD_MAX_PARTS    (1 << 11)
+#define FM_BUCKET_ORDER_MIN     (1 << 14) // Smaller maps rebuild in dense order
+#define FM_PARALLEL_REBUILD_MIN (1 << 20) // Smaller maps rebuild on one thread
+
+typedef struct {
+    _FastMap* map;
+    fm_table* t;
+    uint32_t shift;
+    size_t parts;
+    size_t tasks;
+    size_t largest;          // Entries in the fullest window
+    size_t* cursors;         // tasks x parts: histogram, then scatter positions
+    size_t* starts;          // Window boundaries in by_part (parts + 1)
+    uint64_t* by_part;       // (home << 32 | vec_idx) grouped by window
+    uint64_t* by_part_hash;  // Matching hashes, tagged layouts only
+    uint32_t* local_counts;  // Per region: window histogram
+    uint64_t* sorted;        // Per region: one window sorted by home ('largest' items)
+    uint64_t* sorted_hash;   // Matching hashes, tagged layouts only
+    fm_vector* spill;        // Per region: items past the region end
+    uint8_t* status;         // Per region: FM_REBUILD_*
+} fm_rebuild_job;
+
+#define FM_REBUILD_OK       0
+#define FM_REBUILD_OVERFLOW 1 // Packed probe distance overflow
+#define FM_REBUILD_NOMEM    2 // Spill could not grow
+
+static inline void fm_rebuild_count(void* arg, size_t task) {
+    fm_rebuild_job* job = (fm_rebuild_job*)arg;
+    size_t n = job->map->keys.length, mask = job->t->bucket_mask;
+    size_t* counts = job->cursors + task * job->parts;
+    for (size_t i = n * task / job->tasks; i < n * (task + 1) / job->tasks; i++) {
+        counts[(fm_hash_at(job->map, i) & mask) >> job->shift]++;
+    }
+}
+
+static inline void fm_rebuild_scatter(void* arg, size_t task) {
+    fm_rebuild_job* job = (fm_rebuild_job*)arg;
+    size_t n = job->map->keys.length, mask = job->t->bucket_mask;
+    size_t* cursors = job->cursors + task * job->parts;
+    for (size_t i = n * task / job->tasks; i < n * (task + 1) / job->tasks; i++) {
+        uint64_t hash = fm_hash_at(job->map, i), home = hash & mask;
+        size_t at = cursors[home >> job->shift]++;
+        job->by_part[at] = (home << 32) | i;
+        if (job->by_part_hash) job->by_part_hash[at] = hash;
+    }
+}
+
+static inline void fm_rebuild_fill(void* arg, size_t task) {
+    fm_rebuild_job* job = (fm_rebuild_job*)arg;
+    size_t first = job->parts * task / job->tasks;
+    size_t last = job->parts * (task + 1) / job->tasks;
+    size_t window = (size_t)1 << job->shift;
+    size_t end = last << job->shift;
+    bool tagged = job->by_part_hash != NULL;
+    uint32_t* local_counts = job->local_counts + task * window;
+    uint64_t* sorted = job->sorted + task * job->largest;
+    uint64_t* sorted_hash = tagged ? job->sorted_hash + task * job->largest : NULL;
+
+    size_t next = first << job->shift;
+    bool spilling = false;
+    for (size_t p = first; p < last; p++) {
+        size_t begin = job->starts[p], count = job->starts[p + 1] - begin;
+        size_t base = p << job->shift;
+        const uint64_t* part = job->by_part + begin;
+
+        memset(local_counts, 0, window * sizeof(uint32_t));
+        for (size_t i = 0; i < count; i++) local_counts[(part[i] >> 32) - base]++;
+        uint32_t sum = 0;
+        for (size_t b = 0; b < window; b++) {
+            uint32_t c = local_counts[b];
+            local_counts[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t at = local_counts[(part[i] >> 32) - base]++;
+            sorted[at] = part[i];
+            if (tagged) sorted_hash[at] = job->by_part_hash[begin + i];
+        }
+
+        size_t done = spilling ? 0 : fm_fill_sorted(job->map, job->t, sorted, sorted_hash, count, &next, end);
+        if (done == FM_NPOS) {
+            job->status[task] = FM_REBUILD_OVERFLOW;
+            break;
+        }
+        if (done < count) {
+            spilling = true;
+            if (!fm_vec_try_make_room(&job->spill[task], count - done)) {
+                job->status[task] = FM_REBUILD_NOMEM;
+                break;
+            }
+            fm_vec_append(&job->spill[task], sorted + done, count - done);
+        }
+    }
+}
 
+static inline void fm_rebuild_job_free(fm_rebuild_job* job, size_t n) {
+    const fm_allocator* a = job->map->allocator;
+    size_t window = (size_t)1 << job->shift;
+    if (job->spill) {
+        for (size_t w = 0; w < job->tasks; w++) fm_vec_free(&job->spill[w]);
+    }
+    fm_mem_free(a, job->cursors, job->tasks * job->parts * sizeof(size_t));
+    fm_mem_free(a, job->starts, (job->parts + 1) * sizeof(size_t));
+    fm_mem_free(a, job->by_part, n * sizeof(uint64_t));
+    fm_mem_free(a, job->by_part_hash, n * sizeof(uint64_t));
+    fm_mem_free(a, job->local_counts, job->tasks * window * sizeof(uint32_t));
+    fm_mem_free(a, job->sorted, job->tasks * job->largest * sizeof(uint64_t));
+    fm_mem_free(a, job->sorted_hash, job->tasks * job->largest * sizeof(uint64_t));
+    fm_mem_free(a, job->spill, job->tasks * sizeof(fm_vector));
+    fm_mem_free(a, job->status, job->tasks);
+}
+
+static inline bool fm_rebuild_bucket_order(_FastMap* map, fm_table* t) {
+    size_t n = map->keys.length;
+    if (!fm_items_fit(n, t->bucket_count)) return fm_rebuild_dense(map, t);
+    const fm_allocator* a = map->allocator;
+    fm_rebuild_job job;
+    memset(&job, 0, sizeof(job));
+    job.map = map;
+    job.t = t;
+
+    job.shift = FM_REBUILD_WINDOW_BITS;
+    while ((t->bucket_count >> job.shift) > FM_REBUILD_MAX_PARTS) job.shift++;
+    job.parts = t->bucket_count >> job.shift;
+    if (job.parts == 0) return fm_rebuild_dense(map, t);
+
+    job.tasks = 1;
+    if (map->resize_threads > 1 && n >= FM_PARALLEL_REBUILD_MIN) job.tasks = map->resize_threads;
+    if (job.tasks > job.parts) job.tasks = job.parts;
+    fm_parallel_for_fn run = map->parallel_for ? map->parallel_for : fm_parallel_for_default;
+    bool tagged = t->slots || t->ctrl;
+    size_t window = (size_t)1 << job.shift;
+
+    job.cursors = (size_t*)fm_mem_alloc(a, job.tasks * job.parts * sizeof(size_t));
+    job.starts = (size_t*)fm_mem_alloc(a, (job.parts + 1) * sizeof(size_t));
+    job.by_part = (uint64_t*)fm_mem_alloc(a, n * sizeof(uint64_t));
+    job.by_part_hash = tagged ? (uint64_t*)fm_mem_alloc(a, n * sizeof(uint64_t)) : NULL;
+    job.local_counts = (uint32_t*)fm_mem_alloc(a, job.tasks * window * sizeof(uint32_t));
+    job.spill = (fm_vector*)fm_mem_alloc(a, job.tasks * sizeof(fm_vector));
+    job.status = (uint8_t*)fm_mem_alloc(a, job.tasks);
+    if (job.spill) memset(job.spill, 0, job.tasks * sizeof(fm_vector)); // Safe to free before init
+    if (!job.cursors || !job.starts || !job.by_part || (tagged && !job.by_part_hash) || !job.local_counts ||
+        !job.spill || !job.status) {
+        fm_rebuild_job_free(&job, n);
+        return fm_rebuild_dense(map, t);
+    }
+    memset(job.cursors, 0, job.tasks * job.parts * sizeof(size_t));
+    for (size_t w = 0; w < job.tasks; w++) {
+        fm_vec_init(&job.spill[w], sizeof(uint64_t), 0, a);
+        job.status[w] = FM_REBUILD_OK;
+    }
+
+    // Pass 1: partition by window. Each worker scatters into its own slice
+    // of every window, so the prefix sum runs window-major.
+    if (job.tasks > 1) run(map->parallel_ctx, fm_rebuild_count, &job, job.tasks);
+    else fm_rebuild_count(&job, 0);
+    size_t sum = 0;
+    size_t largest = 1;
+    for (size_t p = 0; p < job.parts; p++) {
+        job.starts[p] = sum;
+        for (size_t w = 0; w < job.tasks; w++) {
+            size_t c = job.cursors[w * job.parts + p];
+            job.cursors[w * job.parts + p] = sum;
+            sum += c;
+        }
+        if (sum - job.starts[p] > largest) largest = sum - job.starts[p];
+    }
+    job.starts[job.parts] = sum;
+
+    job.largest = largest;
+    job.sorted = (uint64_t*)fm_mem_alloc(a, job.tasks * largest * sizeof(uint64_t));
+    job.sorted_hash = tagged ? (uint64_t*)fm_mem_alloc(a, job.tasks * largest * sizeof(uint64_t)) : NULL;
+    if (!job.sorted || (tagged && !job.sorted_hash)) {
+        fm_rebuild_job_free(&job, n);
+        return fm_rebuild_dense(map, t);
+    }
+    if (job.tasks > 1) run(map->parallel_ctx, fm_rebuild_scatter, &job, job.tasks);
+    else fm_rebuild_scatter(&job, 0);
+
+    // Pass 2: sweep each region, then fix up what ran past region ends
+    if (job.tasks > 1) run(map->parallel_ctx, fm_rebuild_fill, &job, job.tasks);
+    else fm_rebuild_fill(&job, 0);
+    bool placed = true, nomem = false;
+    for (size_t w = 0; w < job.tasks; w++) {
+        nomem = nomem || job.status[w] == FM_REBUILD_NOMEM;
+        placed = placed && job.status[w] == FM_REBUILD_OK &&
+                 fm_place_items(map, t, (const uint64_t*)job.spill[w].data, job.spill[w].length);
+    }
+    fm_rebuild_job_free(&job, n);
+
+    if (nomem) {
+        fm_table_clear(t);
+        return fm_rebuild_dense(map, t);
+    }
+    return placed;
+}
+
+// Re-inserts every existing item into an empty bucket array. False if a
+// packed probe chain outgrew the distance byte: the caller spreads it over
+// twice the buckets and tries again.
+static inline bool fm_rebuild_into(_FastMap* map, fm_table* t) {
+    return map->keys.length >= FM_BUCKET_ORDER_MIN ? fm_rebuild_bucket_order(map, t) : fm_rebuild_dense(map, t);
+}
+
+// Builds a new index of at least 'new_capacity' buckets from the dense
+// vectors, without touching the map's own tables. False if the table
+// cannot be allocated.
+static inline bool fm_try_rebuild_table(_FastMap* map, size_t new_capacity, fm_table* out) {
     while (true) {
-        uint32_t idx = map->buckets[bucket_idx];
-        
-        if (idx == FM_EMPTY_IDX) return NULL; // Not found
+        if (!fm_table_try_alloc(out, new_capacity, map->flags, map->allocator)) return false;
+        if (fm_rebuild_into(map, out)) return true;
+        fm_table_free(out);
+        new_capacity *= 2;
+    }
+}
+
+static inline fm_table fm_rebuild_table(_FastMap* map, size_t new_capacity) {
+    fm_table t;
+    if (!fm_try_rebuild_table(map, new_capacity, &t)) abort(); // Handle OOM
+    return t;
+}
 
-        // Check Hash & Key
-        void* existing_key = fm_vec_at(&map->keys, idx);
-        if (memcmp(existing_key, key, map->key_size) == 0) {
-            return fm_vec_at(&map->values, idx);
+// Moves a fused map into a new block of at least 'bucket_count' buckets.
+// The index is rebuilt from the old block's hashes, then the entries are
+// copied over. False, with the map unchanged, if the block is unavailable.
+static inline bool fm_fused_try_resize(_FastMap* map, size_t bucket_count) {
+    size_t n = map->keys.length;
+    while (true) {
+        size_t cap = (size_t)((float)bucket_count * map->max_load_factor);
+        if (cap < n) cap = n;
+        fm_fused_layout l = fm_fused_plan(map, bucket_count, cap);
+        unsigned char* block = (unsigned char*)fm_mem_alloc(map->allocator, l.bytes);
+        if (!block) return false;
+
+        fm_table t = fm_fused_table(map, block, &l, bucket_count);
+        if (!fm_rebuild_into(map, &t)) {
+            fm_mem_free(map->allocator, block, l.bytes);
+            bucket_count *= 2;
+            continue;
+        }
+
+        if (n > 0) {
+            memcpy(block, map->hashes.data, n * sizeof(uint64_t));
+            memcpy(block + l.keys, map->keys.data, n * map->key_size);
+            memcpy(block + l.values, map->values.data, n * map->val_size);
         }
+        fm_mem_free(map->allocator, map->hashes.data, fm_fused_bytes(map));
+        fm_fused_install(map, block, &l, &t);
+        return true;
+    }
+}
+
+// Gives a small map its index: 16 buckets, and vectors of its own unless
+// the map is fused. False, with the map unchanged, if memory runs out.
+static inline bool fm_small_try_promote(_FastMap* map) {
+    size_t n = map->keys.length, buckets = 16;
+    if (map->flags & FM_OPT_FUSED) return fm_fused_try_resize(map, buckets);
+
+    const fm_allocator* alloc = map->allocator;
+    fm_vector keys, values, hashes;
+    fm_vec_init(&keys, map->keys.stride, 0, alloc);
+    fm_vec_init(&values, map->values.stride, 0, alloc);
+    fm_vec_init(&hashes, sizeof(uint64_t), 0, alloc);
+    fm_table t;
+    memset(&t, 0, sizeof(t));
+    if (!fm_vec_try_reserve(&keys, buckets) || !fm_vec_try_reserve(&values, buckets) ||
+        !fm_vec_try_reserve(&hashes, buckets) || !fm_table_try_alloc(&t, buckets, map->flags, alloc)) {
+        fm_vec_free(&keys);
+        fm_vec_free(&values);
+        fm_vec_free(&hashes);
+        return false;
+    }
+    fm_rebuild_dense(map, &t); // A handful of entries cannot overflow a packed slot
+
+    if (n > 0) {
+        memcpy(keys.data, map->keys.data, n * keys.stride);
+        memcpy(values.data, map->values.data, n * values.stride);
+        memcpy(hashes.data, map->hashes.data, n * sizeof(uint64_t));
+    }
+    keys.length = values.length = hashes.length = n;
+    fm_mem_free(alloc, map->hashes.data, fm_fused_bytes(map));
+    map->keys = keys;
+    map->values = values;
+    map->hashes = hashes;
+    map->table = t;
+    return true;
+}
+
+// Most entries a map can index: FM_EMPTY_IDX is reserved, and packed
+// slots hold FM_SLOT_IDX_BITS of index
+static inline uint64_t fm_max_entries(const _FastMap* map) {
+    uint64_t limit = (uint64_t)FM_EMPTY_IDX - 1;
+    if ((map->flags & FM_OPT_PACKED_BUCKETS) && FM_SLOT_IDX_MASK < limit) limit = FM_SLOT_IDX_MASK;
+    return limit;
+}
+
+// False if a 'bucket_count' table would let the map fill past
+// fm_max_entries before it next grows. Growth is the only place this is
+// checked, so the put path pays nothing for it.
+static inline bool fm_index_fits(const _FastMap* map, size_t bucket_count) {
+    return (double)bucket_count * map->max_load_factor <= (double)fm_max_entries(map);
+}
+
+// Blocking rebuild of the whole index from the dense vectors. Any migration
+// in progress is simply dropped: the vectors hold every entry either way.
+// If the new index cannot be allocated, or would outgrow fm_index, the map
+// is left as it was.
+static inline bool fm_try_resize(_FastMap* map, size_t new_capacity) {
+    if (!fm_index_fits(map, new_capacity)) return false;
+    if (map->table.bucket_count == 0 && !fm_small_try_promote(map)) return false;
+    if (map->flags & FM_OPT_FUSED) {
+        if (!fm_fused_try_resize(map, new_capacity)) return false;
+        FM_COUNT(map, resizes);
+        return true;
+    }
+
+    fm_table new_table;
+    if (!fm_try_rebuild_table(map, new_capacity, &new_table)) return false;
+
+    FM_COUNT(map, resizes);
+    fm_table_free(&map->old_table);
+    map->migrate_left = 0;
+    fm_table_free(&map->table);
+    map->table = new_table;
+    return true;
+}
+
+static inline void fm_resize(_FastMap* map, size_t new_capacity) {
+    if (!fm_try_resize(map, new_capacity)) abort(); // Handle OOM (or index overflow)
+}
+
+static inline bool fm_slot_empty(const fm_table* t, size_t bucket_idx) {
+    return t->slots ? t->slots[bucket_idx] == FM_SLOT_EMPTY
+                    : fm_bucket_load(t->buckets, bucket_idx, t->width) == FM_EMPTY_IDX;
+}
+
+// Vector index stored in a bucket
+static inline fm_index fm_bucket_index(const fm_table* t, size_t bucket_idx) {
+    return t->slots ? (fm_index)(t->slots[bucket_idx] & FM_SLOT_IDX_MASK)
+                    : fm_bucket_load(t->buckets, bucket_idx, t->width);
+}
+
+// Old buckets migrated per put/erase. An N-bucket table is drained within
+// N / 64 updates, long before the 2N-bucket table reaches its load limit.
+#define FM_MIGRATE_STEP 64
+
+// Moves up to 'budget' old buckets into the new table. Whole clusters move
+// at once and are then cleared, so the old table stays a valid Robin Hood
+// table for the entries it still owns. The sweep starts at an empty bucket,
+// and the old table never receives inserts, so no cluster straddles it.
+static inline void fm_migrate_step(_FastMap* map, size_t budget) {
+    fm_table* old = &map->old_table;
+    size_t work = 0;
+
+    while (map->migrate_left > 0 && work < budget) {
+        size_t start = map->migrate_pos;
+        size_t end = start;
+        while (!fm_slot_empty(old, end)) {
+            fm_index idx = fm_bucket_index(old, end);
+            uint64_t h = fm_hash_at(map, idx);
+            if (!fm_table_place(map, &map->table, h, idx)) {
+                fm_resize(map, map->table.bucket_count * 2); // Packed overflow: finish the hard way
+                return;
+            }
+            end = (end + 1) & old->bucket_mask;
+        }
+
+        size_t len = (end - start) & old->bucket_mask;
+        for (size_t i = start; i != end; i = (i + 1) & old->bucket_mask) {
+            if (old->slots) {
+                old->slots[i] = FM_SLOT_EMPTY;
+            } else {
+                fm_bucket_store(old->buckets, i, FM_EMPTY_IDX, old->width);
+                if (old->ctrl) fm_ctrl_set(old->ctrl, old->bucket_count, i, FM_CTRL_EMPTY);
+            }
+        }
+
+        // Consume the cluster plus the empty bucket that ends it (the last
+        // cluster ends on the bucket the sweep started from, already counted)
+        size_t consumed = len + 1 < map->migrate_left ? len + 1 : map->migrate_left;
+        map->migrate_pos = (end + 1) & old->bucket_mask;
+        map->migrate_left -= consumed;
+        work += consumed;
+    }
+
+    if (map->migrate_left == 0) fm_table_free(old);
+}
+
+// Grows the index: a blocking rebuild, or the start of an incremental one.
+// False, with the entries still all indexed, if memory runs out.
+static inline bool fm_try_grow(_FastMap* map) {
+    if (map->table.bucket_count == 0) { // Small: the first block, or the switch to an index
+        if (map->keys.capacity == 0) return fm_small_try_alloc(map);
+        if (!fm_small_try_promote(map)) return false;
+        FM_COUNT(map, resizes);
+        return true;
+    }
+    if (!(map->flags & FM_OPT_INCREMENTAL)) return fm_try_resize(map, map->table.bucket_count * 2);
+
+    // Finish the previous migration (normally already done by now)
+    fm_migrate_step(map, map->old_table.bucket_count);
+
+    fm_table fresh;
+    if (!fm_index_fits(map, map->table.bucket_count * 2)) return false;
+    if (!fm_table_try_alloc(&fresh, map->table.bucket_count * 2, map->flags, map->allocator)) return false;
+    FM_COUNT(map, resizes);
+
+    fm_table* old = &map->old_table;
+    *old = map->table;
+    map->table = fresh;
+
+    // Sweep cyclically from an empty bucket (one exists: load factor < 1)
+    size_t start = 0;
+    while (!fm_slot_empty(old, start)) start++;
+    map->migrate_pos = start;
+    map->migrate_left = old->bucket_count;
+    return true;
+}
+
+static inline void fm_grow(_FastMap* map) {
+    if (!fm_try_grow(map)) abort(); // Handle OOM (or index overflow)
+}
+
+// Sizes the index and the dense vectors for 'n' entries in one step, so
+// loading n entries afterwards never rehashes or reallocates.
+static inline void fm_reserve(_FastMap* map, size_t n) {
+    if (map->table.bucket_count == 0) {
+        if (n > FM_SMALL_MAX) {
+            if (!fm_small_try_promote(map)) abort(); // Handle OOM
+        } else {
+            if (n > map->keys.capacity && !fm_small_try_alloc(map)) abort(); // Handle OOM
+            return;
+        }
+    }
+    if (map->flags & FM_OPT_FUSED) {
+        size_t buckets = map->table.bucket_count;
+        while (n > buckets * map->max_load_factor) buckets *= 2;
+        if (buckets > map->table.bucket_count || n > map->keys.capacity) fm_resize(map, buckets);
+        return;
+    }
+    fm_vec_reserve(&map->keys, n);
+    fm_vec_reserve(&map->values, n);
+    if (fm_caches_hashes(map)) fm_vec_reserve(&map->hashes, n);
+
+    size_t buckets = map->table.bucket_count;
+    while (n > buckets * map->max_load_factor) buckets *= 2;
+    if (buckets > map->table.bucket_count) fm_resize(map, buckets);
+}
+
+// Initialize the map pre-sized for 'n' entries (see fm_reserve)
+static inline _FastMap fm_init_with_capacity(size_t key_size, size_t val_size, size_t n) {
+    _FastMap map = fm_init(key_size, val_size);
+    fm_reserve(&map, n);
+    return map;
+}
+
+// Places a freshly appended entry, growing if the packed layout overflows
+static inline void fm_place(_FastMap* map, uint64_t hash, fm_index vec_idx) {
+    if (map->table.bucket_count == 0) return; // Small: the scan finds it
+    if (!fm_table_place(map, &map->table, hash, vec_idx)) {
+        fm_resize(map, map->table.bucket_count * 2);
+    }
+}
+
+// Control-byte probe: returns the bucket holding 'key', or FM_NPOS.
+// Linear probing never leaves a hole inside a probe sequence, so the key can
+// only sit before the first empty tag; one group with an empty ends the search.
+FM_FORCE_INLINE size_t fm_find_bucket_ctrl(_FastMap* map, const fm_table* t, const void* key, uint64_t hash,
+                                           size_t key_size, fm_key_eq_fn eq) {
+    uint8_t tag = fm_ctrl_tag(hash);
+    size_t pos = hash & t->bucket_mask;
+
+    while (true) {
+        FM_COUNT(map, probes);
+        const uint8_t* group = t->ctrl + pos;
+        uint32_t match = fm_group_match(group, tag);
+        uint32_t empty = fm_group_empty(group);
+        if (empty) match &= (empty & (0u - empty)) - 1; // Drop tags past the first hole
+
+        while (match) {
+            size_t bucket_idx = (pos + fm_ctz32(match)) & t->bucket_mask;
+            const void* existing_key = map->keys.data + (size_t)t->buckets[bucket_idx] * key_size;
+            FM_COUNT(map, key_compares);
+            if (eq(map, existing_key, key)) return bucket_idx;
+            match &= match - 1;
+        }
+
+        if (empty) return FM_NPOS;
+        pos = (pos + FM_GROUP_WIDTH) & t->bucket_mask;
+    }
+}
+
+// Packed probe: the early exit and the fingerprint filter never leave the
+// slot array. A stored key at distance d has exactly d in its slot, so the
+// distance and fingerprint are checked with a single compare.
+FM_FORCE_INLINE size_t fm_find_bucket_packed(_FastMap* map, const fm_table* t, const void* key, uint64_t hash,
+                                             size_t key_size, fm_key_eq_fn eq) {
+    size_t bucket_idx = hash & t->bucket_mask;
+    uint64_t want = fm_slot_make(0, hash, 0) >> FM_SLOT_IDX_BITS; // Distance + fingerprint
+
+    while (true) {
+        FM_COUNT(map, probes);
+        uint64_t slot = t->slots[bucket_idx];
+        uint64_t meta = slot >> FM_SLOT_IDX_BITS;
+
+        // Robin Hood Early Exit (an empty slot has the lowest possible distance)
+        if (meta < (want & (FM_SLOT_DIST_MASK >> FM_SLOT_IDX_BITS))) {
+            if (slot != FM_SLOT_EMPTY) FM_COUNT(map, early_exits);
+            return FM_NPOS;
+        }
+
+        if (meta == want) {
+            const void* existing_key = map->keys.data + (size_t)(slot & FM_SLOT_IDX_MASK) * key_size;
+            FM_COUNT(map, key_compares);
+            if (eq(map, existing_key, key)) return bucket_idx;
+        }
+
+        bucket_idx = (bucket_idx + 1) & t->bucket_mask;
+        want += FM_SLOT_DIST_ONE >> FM_SLOT_IDX_BITS;
+    }
+}
+
+// Plain bucket probe over a 'width'-byte bucket array (a constant at
+// every call site, so each width gets its own loop)
+FM_FORCE_INLINE size_t fm_find_bucket_plain(_FastMap* map, const fm_table* t, const void* key, uint64_t hash,
+                                            size_t key_size, fm_key_eq_fn eq, size_t width) {
+    size_t bucket_idx = hash & t->bucket_mask;
+    size_t dist = 0; // Track our distance for early exit
+
+    while (true) {
+        FM_COUNT(map, probes);
+        fm_index idx = fm_bucket_load(t->buckets, bucket_idx, width);
+
+        if (idx == FM_EMPTY_IDX) return FM_NPOS; // Not found
 
         // Robin Hood Early Exit
-        uint64_t existing_hash = *(uint64_t*)fm_vec_at(&map->hashes, idx);
-        size_t ideal_idx = existing_hash & map->bucket_mask;
-        uint32_t existing_dist = (bucket_idx + map->bucket_mask + 1 - ideal_idx) & map->bucket_mask;
-        
-        if (existing_dist < dist) return NULL; // Impossible to be further down
+        uint64_t existing_hash = fm_hash_at(map, idx);
+        size_t ideal_idx = existing_hash & t->bucket_mask;
+        uint32_t existing_dist = (bucket_idx + t->bucket_mask + 1 - ideal_idx) & t->bucket_mask;
+        if (existing_dist < dist) { // Impossible to be further down
+            FM_COUNT(map, early_exits);
+            return FM_NPOS;
+        }
+
+        // Check for Match (the cached hash is already loaded; the key is
+        // only touched when all 64 bits agree)
+        if (existing_hash == hash) {
+            const void* existing_key = map->keys.data + (size_t)idx * key_size;
+            FM_COUNT(map, key_compares);
+            if (eq(map, existing_key, key)) return bucket_idx;
+        }
 
-        bucket_idx = (bucket_idx + 1) & map->bucket_mask;
+        bucket_idx = (bucket_idx + 1) & t->bucket_mask;
         dist++;
     }
 }
 
-// Helper: updates the bucket that points to a specific vector index
-static inline void fm_update_bucket_for_moved_item(_FastMap* map, uint32_t old_vec_idx, uint32_t new_vec_idx) {
+// Returns the bucket of 't' holding 'key', or FM_NPOS
+FM_FORCE_INLINE size_t fm_find_bucket(_FastMap* map, const fm_table* t, const void* key, uint64_t hash,
+                                      size_t key_size, fm_key_eq_fn eq) {
+    if (t->slots) return fm_find_bucket_packed(map, t, key, hash, key_size, eq);
+    if (t->ctrl) return fm_find_bucket_ctrl(map, t, key, hash, key_size, eq);
+    if (t->width == sizeof(fm_index)) return fm_find_bucket_plain(map, t, key, hash, key_size, eq, sizeof(fm_index));
+    if (t->width == 1) return fm_find_bucket_plain(map, t, key, hash, key_size, eq, 1);
+    if (t->width == 2) return fm_find_bucket_plain(map, t, key, hash, key_size, eq, 2);
+    return fm_find_bucket_plain(map, t, key, hash, key_size, eq, 4); // Only with FM_INDEX_64
+}
+
+// Bit i set: cached hash i equals 'hash', for the first 'n' entries of a
+// small map. Reads all FM_SMALL_MAX slots; the ones past 'n' are masked off.
+FM_FORCE_INLINE uint32_t fm_small_match(const uint64_t* hashes, size_t n, uint64_t hash) {
+#if defined(FM_HAVE_SSE2)
+    // No 64-bit compare in SSE2: both 32-bit halves must match
+    __m128i h = _mm_set1_epi64x((long long)hash);
+    uint32_t match = 0;
+    for (size_t i = 0; i < FM_SMALL_MAX; i += 2) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(hashes + i)), h);
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        match |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+    }
+    return match & (uint32_t)(((uint64_t)1 << n) - 1);
+#else
+    uint32_t match = 0;
+    for (size_t i = 0; i < n; i++) match |= (uint32_t)(hashes[i] == hash) << i;
+    return match;
+#endif
+}
+
+// Small-map lookup: returns the vector index of 'key', or FM_NPOS
+FM_FORCE_INLINE size_t fm_small_find(_FastMap* map, const void* key, uint64_t hash, size_t key_size,
+                                     fm_key_eq_fn eq) {
+    size_t n = map->keys.length;
+    if (n == 0) return FM_NPOS; // Possibly no block yet
+    uint32_t match = fm_small_match((const uint64_t*)map->hashes.data, n, hash);
+    while (match) {
+        size_t idx = fm_ctz32(match);
+        FM_COUNT(map, key_compares);
+        if (eq(map, map->keys.data + idx * key_size, key)) return idx;
+        match &= match - 1;
+    }
+    return FM_NPOS;
+}
+
+// Finds 'key' in whichever table owns it. Returns the vector index, or
+// FM_NPOS; '*owner' / '*bucket' (optional) receive where it was found.
+// In a small map '*bucket' is the vector index itself.
+FM_FORCE_INLINE size_t fm_lookup(_FastMap* map, const void* key, uint64_t hash, fm_table** owner, size_t* bucket,
+                                 size_t key_size, fm_key_eq_fn eq) {
+    FM_COUNT(map, lookups);
+    fm_table* t = &map->table;
+    if (t->bucket_count == 0) {
+        size_t idx = fm_small_find(map, key, hash, key_size, eq);
+        if (owner) *owner = t;
+        if (bucket) *bucket = idx;
+        return idx;
+    }
+    size_t bucket_idx = fm_find_bucket(map, t, key, hash, key_size, eq);
+
+    if (bucket_idx == FM_NPOS && map->migrate_left > 0) {
+        t = &map->old_table;
+        bucket_idx = fm_find_bucket(map, t, key, hash, key_size, eq);
+    }
+    if (bucket_idx == FM_NPOS) return FM_NPOS;
+
+    if (owner) *owner = t;
+    if (bucket) *bucket = bucket_idx;
+    return fm_bucket_index(t, bucket_idx);
+}
+
+// Helper: updates the bucket of 't' that points to a specific vector index.
+// Returns false if 't' does not hold it (the probe stops at the cluster end).
+static inline bool fm_update_bucket_for_moved_item(_FastMap* map, fm_table* t, fm_index old_vec_idx, fm_index new_vec_idx) {
     // We have to find the bucket pointing to old_vec_idx and update it.
     // To do this fast, we use the stored hash of the MOVED item.
     
-    uint64_t hash = *(uint64_t*)fm_vec_at(&map->hashes, new_vec_idx);
-    size_t bucket_idx = hash & map->bucket_mask;
+    uint64_t hash = fm_hash_at(map, new_vec_idx);
+    size_t bucket_idx = hash & t->bucket_mask;
+
+    while (!fm_slot_empty(t, bucket_idx)) {
+        if (fm_bucket_index(t, bucket_idx) == old_vec_idx) {
+            if (t->slots) {
+                t->slots[bucket_idx] = (t->slots[bucket_idx] & ~FM_SLOT_IDX_MASK) | new_vec_idx;
+            } else {
+                fm_bucket_store(t->buckets, bucket_idx, new_vec_idx, t->width);
+            }
+            return true;
+        }
+        bucket_idx = (bucket_idx + 1) & t->bucket_mask;
+    }
+    return false;
+}
 
+// Packed backshift: every follower with a non-zero distance slides back one
+// slot, and its distance is decremented in place.
+static inline void fm_backshift_packed(fm_table* t, size_t hole_idx) {
     while (true) {
-        if (map->buckets[bucket_idx] == old_vec_idx) {
-            map->buckets[bucket_idx] = new_vec_idx;
+        size_t next_idx = (hole_idx + 1) & t->bucket_mask;
+        uint64_t next = t->slots[next_idx];
+
+        if (next < FM_SLOT_DIST_ONE * 2) { // Empty, or already at its home
+            t->slots[hole_idx] = FM_SLOT_EMPTY;
             return;
         }
-        bucket_idx = (bucket_idx + 1) & map->bucket_mask;
+
+        t->slots[hole_idx] = next - FM_SLOT_DIST_ONE;
+        hole_idx = next_idx;
     }
 }
 
-// The Delete Function
-static inline bool fm_erase(_FastMap* map, const void* key) {
-    uint64_t hash = fm_hash(key, map->key_size);
-    size_t bucket_idx = hash & map->bucket_mask;
-    size_t dist = 0;
+// Removes the entry referenced by bucket 'bucket_idx' of 't' (Swap-and-Pop + Backshift)
+FM_FORCE_INLINE void fm_erase_at(_FastMap* map, fm_table* t, size_t bucket_idx, size_t key_size, size_t val_size) {
+    FM_COUNT(map, erases);
+    bool small = t->bucket_count == 0; // No index: 'bucket_idx' is the vector index
+    fm_index vec_idx = small ? (fm_index)bucket_idx : fm_bucket_index(t, bucket_idx);
+
+    // A. SWAP-AND-POP from Vectors
+    // We move the LAST item in the vector into this slot to fill the hole.
+    fm_index last_vec_idx = (fm_index)map->keys.length - 1;
+    
+    if (vec_idx != last_vec_idx) {
+        // Move Key
+        void* dst_k = map->keys.data + (size_t)vec_idx * key_size;
+        void* src_k = map->keys.data + (size_t)last_vec_idx * key_size;
+        memcpy(dst_k, src_k, key_size);
+
+        // Move Value
+        void* dst_v = map->values.data + (size_t)vec_idx * val_size;
+        void* src_v = map->values.data + (size_t)last_vec_idx * val_size;
+        memcpy(dst_v, src_v, val_size);
+
+        // Move Hash
+        if (fm_caches_hashes(map)) {
+            uint64_t* hashes = (uint64_t*)map->hashes.data;
+            hashes[vec_idx] = hashes[last_vec_idx];
+        }
+
+        // CRITICAL: The bucket that pointed to 'last_vec_idx' implies it is
+        // strictly pointing to the end. We must find that bucket and update 
+        // it to point to 'vec_idx' (the new location). Mid-migration it may
+        // still live in the old table.
+        if (!small && !fm_update_bucket_for_moved_item(map, &map->table, last_vec_idx, vec_idx)) {
+            fm_update_bucket_for_moved_item(map, &map->old_table, last_vec_idx, vec_idx);
+        }
+    }
+
+    // Decrease size (Pop)
+    map->keys.length--;
+    map->values.length--;
+    if (fm_caches_hashes(map)) map->hashes.length--;
+    if (small) return;
+
+    // B. BACKSHIFT DELETION in Buckets
+    // The current 'bucket_idx' is now effectively "empty".
+    // We must fill it by shifting neighboring items back if they are probing.
+    if (t->slots) {
+        fm_backshift_packed(t, bucket_idx);
+        return;
+    }
+    
+    size_t hole_idx = bucket_idx;
+    size_t next_idx = (hole_idx + 1) & t->bucket_mask;
 
     while (true) {
-        uint32_t vec_idx = map->buckets[bucket_idx];
+        fm_index next_val = fm_bucket_load(t->buckets, next_idx, t->width);
         
-        // 1. Not Found (Empty or Early Exit)
-        if (vec_idx == FM_EMPTY_IDX) return false;
-
-        // Robin Hood Early Exit Check
-        uint64_t existing_hash = *(uint64_t*)fm_vec_at(&map->hashes, vec_idx);
-        size_t ideal_idx = existing_hash & map->bucket_mask;
-        uint32_t existing_dist = (bucket_idx + map->bucket_mask + 1 - ideal_idx) & map->bucket_mask;
-        if (existing_dist < dist) return false;
-
-        // 2. Found Match?
-        void* current_key = fm_vec_at(&map->keys, vec_idx);
-        if (memcmp(current_key, key, map->key_size) == 0) {
-            // === FOUND IT. DELETE LOGIC STARTS ===
-
-            // A. SWAP-AND-POP from Vectors
-            // We move the LAST item in the vector into this slot to fill the hole.
-            uint32_t last_vec_idx = (uint32_t)map->keys.length - 1;
-            
-            if (vec_idx != last_vec_idx) {
-                // Move Key
-                void* dst_k = fm_vec_at(&map->keys, vec_idx);
-                void* src_k = fm_vec_at(&map->keys, last_vec_idx);
-                memcpy(dst_k, src_k, map->key_size);
-
-                // Move Value
-                void* dst_v = fm_vec_at(&map->values, vec_idx);
-                void* src_v = fm_vec_at(&map->values, last_vec_idx);
-                memcpy(dst_v, src_v, map->val_size);
-
-                // Move Hash
-                void* dst_h = fm_vec_at(&map->hashes, vec_idx);
-                void* src_h = fm_vec_at(&map->hashes, last_vec_idx);
-                memcpy(dst_h, src_h, sizeof(uint64_t));
-
-                // CRITICAL: The bucket that pointed to 'last_vec_idx' implies it is
-                // strictly pointing to the end. We must find that bucket and update 
-                // it to point to 'vec_idx' (the new location).
-                fm_update_bucket_for_moved_item(map, last_vec_idx, vec_idx);
-            }
+        // If next slot is empty, we are done. The hole is at the end of the chain.
+        if (next_val == FM_EMPTY_IDX) {
+            fm_bucket_store(t->buckets, hole_idx, FM_EMPTY_IDX, t->width);
+            if (t->ctrl) fm_ctrl_set(t->ctrl, t->bucket_count, hole_idx, FM_CTRL_EMPTY);
+            return;
+        }
 
-            // Decrease size (Pop)
-            map->keys.length--;
-            map->values.length--;
-            map->hashes.length--;
+        // Calculate where 'next_val' inherently WANTS to be.
+        uint64_t next_hash = fm_hash_at(map, next_val);
+        size_t ideal_idx = next_hash & t->bucket_mask;
+
+        // Check if 'next_val' is currently shifted to the right of 'hole_idx'.
+        // (This logic handles the wrap-around case)
+        size_t dist_to_hole = (hole_idx + t->bucket_count - ideal_idx) & t->bucket_mask;
+        size_t dist_to_next = (next_idx + t->bucket_count - ideal_idx) & t->bucket_mask;
+
+        if (dist_to_hole < dist_to_next) {
+            // The item at 'next_idx' is probing and CAN fit into 'hole_idx'.
+            // Move it back!
+            fm_bucket_store(t->buckets, hole_idx, next_val, t->width);
+            if (t->ctrl) fm_ctrl_set(t->ctrl, t->bucket_count, hole_idx, t->ctrl[next_idx]);
+            hole_idx = next_idx; // The hole moves forward
+        } else {
+            // The item is happy (or blocked by ideal position). 
+            // We cannot move it. The hole stays here? 
+            // Actually in Robin Hood, we just continue scanning.
+        }
 
-            // B. BACKSHIFT DELETION in Buckets
-            // The current 'bucket_idx' is now effectively "empty".
-            // We must fill it by shifting neighboring items back if they are probing.
-            
-            size_t hole_idx = bucket_idx;
-            size_t next_idx = (hole_idx + 1) & map->bucket_mask;
-
-            while (true) {
-                uint32_t next_val = map->buckets[next_idx];
-                
-                // If next slot is empty, we are done. The hole is at the end of the chain.
-                if (next_val == FM_EMPTY_IDX) {
-                    map->buckets[hole_idx] = FM_EMPTY_IDX;
-                    return true;
-                }
+        next_idx = (next_idx + 1) & t->bucket_mask;
+    }
+}
 
-                // Calculate where 'next_val' inherently WANTS to be.
-                uint64_t next_hash = *(uint64_t*)fm_vec_at(&map->hashes, next_val);
-                size_t ideal_idx = next_hash & map->bucket_mask;
-
-                // Check if 'next_val' is currently shifted to the right of 'hole_idx'.
-                // (This logic handles the wrap-around case)
-                size_t dist_to_hole = (hole_idx + map->bucket_count - ideal_idx) & map->bucket_mask;
-                size_t dist_to_next = (next_idx + map->bucket_count - ideal_idx) & map->bucket_mask;
-
-                if (dist_to_hole < dist_to_next) {
-                    // The item at 'next_idx' is probing and CAN fit into 'hole_idx'.
-                    // Move it back!
-                    map->buckets[hole_idx] = next_val;
-                    hole_idx = next_idx; // The hole moves forward
-                } else {
-                    // The item is happy (or blocked by ideal position). 
-                    // We cannot move it. The hole stays here? 
-                    // Actually in Robin Hood, we just continue scanning.
-                }
+// ============================================================================
+// SECTION 6: PUBLIC API (Put / Get / Delete)
+// ============================================================================
+
+// The *_impl functions take the key/value sizes and the key compare
+// explicitly. The generic API below passes the map's runtime sizes and
+// fm_key_eq_bytes; FM_DECLARE passes sizeof() and a typed compare, so each
+// typed map gets its own fully inlined copy of the probe loops.
+
+// Appends a new entry to the dense vectors and indexes it
+FM_FORCE_INLINE void fm_append_entry(_FastMap* map, const void* key, const void* value, uint64_t hash,
+                                     size_t key_size, size_t val_size) {
+    FM_COUNT(map, inserts);
+    fm_index new_idx = (fm_index)map->keys.length;
+    fm_vec_push_n(&map->keys, key, key_size);
+    fm_vec_push_n(&map->values, value, val_size);
+    if (fm_caches_hashes(map)) fm_vec_push_n(&map->hashes, &hash, sizeof(uint64_t)); // Cache the hash!
+
+    // Place index into buckets (Robin Hood logic handles the rest)
+    fm_place(map, hash, new_idx);
+}
+
+// Insert or Update with a precomputed hash (load factor already checked)
+FM_FORCE_INLINE void fm_put_impl(_FastMap* map, const void* key, const void* value, uint64_t hash,
+                                 size_t key_size, size_t val_size, fm_key_eq_fn eq) {
+    if (map->migrate_left > 0) fm_migrate_step(map, FM_MIGRATE_STEP);
+
+    // 2. Probe to see if key exists
+    size_t idx = fm_lookup(map, key, hash, NULL, NULL, key_size, eq);
+    if (idx != FM_NPOS) {
+        // Update Value
+        memcpy(map->values.data + idx * val_size, value, val_size);
+        return;
+    }
+
+    // 3. Insert New
+    fm_append_entry(map, key, value, hash, key_size, val_size);
+}
+
+FM_FORCE_INLINE void* fm_get_impl(_FastMap* map, const void* key, uint64_t hash,
+                                  size_t key_size, size_t val_size, fm_key_eq_fn eq) {
+    size_t idx = fm_lookup(map, key, hash, NULL, NULL, key_size, eq);
+    if (idx == FM_NPOS) return NULL; // Not found
+    return map->values.data + idx * val_size;
+}
+
+FM_FORCE_INLINE bool fm_erase_impl(_FastMap* map, const void* key, uint64_t hash,
+                                   size_t key_size, size_t val_size, fm_key_eq_fn eq) {
+    if (map->migrate_left > 0) fm_migrate_step(map, FM_MIGRATE_STEP);
+
+    fm_table* owner = &map->table;
+    size_t bucket_idx;
+    if (fm_lookup(map, key, hash, &owner, &bucket_idx, key_size, eq) == FM_NPOS) return false; // Not Found (Empty or Early Exit)
+
+    fm_erase_at(map, owner, bucket_idx, key_size, val_size);
+    return true;
+}
+
+// True once the dense vectors have filled the current table (fused
+// vectors end exactly at its load limit, small ones at FM_SMALL_MAX)
+static inline bool fm_needs_grow(const _FastMap* map, size_t extra) {
+    if ((map->flags & FM_OPT_FUSED) || map->table.bucket_count == 0) return map->keys.length + extra > map->keys.capacity;
+    return map->keys.length + extra > map->table.bucket_count * map->max_load_factor;
+}
+
+// Everything an insert may allocate, done up front: grows the index if
+// due and makes room for one more entry (plus 'arena_bytes' of string
+// data). After it succeeds the insert cannot run out of memory; the one
+// exception is the rare packed-layout distance overflow, which still
+// rebuilds through fm_resize.
+static inline bool fm_try_prepare_insert(_FastMap* map, size_t arena_bytes) {
+    if (fm_needs_grow(map, 1) && !fm_try_grow(map)) return false;
+    return fm_vec_try_make_room(&map->keys, 1) && fm_vec_try_make_room(&map->values, 1) &&
+           (!fm_caches_hashes(map) || fm_vec_try_make_room(&map->hashes, 1)) &&
+           (arena_bytes == 0 || fm_vec_try_make_room(&map->arena, arena_bytes)); // Only long strings use it
+}
+
+// ----------------------------------------------------------------------------
+// STRING KEYS (FM_OPT_STRING_KEYS)
+// _FastMap map = FM_INIT_STR(int);
+// fm_put_str(&map, "apple", 5, &v);   int* p = fm_get_str(&map, buf, len);
+// Keys are hashed and compared by content; the caller's bytes are copied,
+// need no NUL terminator and may be freed after the call. Erased long keys
+// stay in the arena until fm_free.
+// ----------------------------------------------------------------------------
 
-                next_idx = (next_idx + 1) & map->bucket_mask;
+// Probe key for string maps: the caller's bytes plus their hash
+typedef struct {
+    const char* ptr;
+    size_t len;
+    uint64_t hash;
+} fm_str_ref;
+
+static inline size_t fm_str_len(const fm_str_key* k) {
+    return k->small.len == FM_STR_IN_ARENA ? k->big.len : k->small.len;
+}
+
+static inline const char* fm_str_data(const _FastMap* map, const fm_str_key* k) {
+    return k->small.len == FM_STR_IN_ARENA ? (const char*)map->arena.data + k->big.offset : k->small.bytes;
+}
+
+// Cached hash, then length, then bytes: a full compare only runs for
+// (almost certainly) equal keys.
+static inline bool fm_str_eq(const _FastMap* map, const void* stored, const void* probe) {
+    const fm_str_key* k = (const fm_str_key*)stored;
+    const fm_str_ref* ref = (const fm_str_ref*)probe;
+    size_t idx = (size_t)(k - (const fm_str_key*)map->keys.data);
+    if (fm_hash_at(map, idx) != ref->hash || fm_str_len(k) != ref->len) return false;
+    return memcmp(fm_str_data(map, k), ref->ptr, ref->len) == 0;
+}
+
+// Builds the stored record, copying long strings into the arena
+static inline fm_str_key fm_str_intern(_FastMap* map, const char* str, size_t len) {
+    fm_str_key k;
+    memset(&k, 0, sizeof(k));
+    if (len <= FM_STR_INLINE_MAX) {
+        memcpy(k.small.bytes, str, len);
+        k.small.len = (uint8_t)len;
+    } else {
+        if (len > UINT32_MAX) abort(); // Lengths are stored in 32 bits
+        k.big.offset = map->arena.length;
+        k.big.len = (uint32_t)len;
+        k.big.tag = FM_STR_IN_ARENA;
+        fm_vec_append(&map->arena, str, len);
+    }
+    return k;
+}
+
+// Initialize a string-keyed map (opts may be NULL)
+static inline _FastMap fm_init_str(size_t val_size, const fm_options* opts) {
+    fm_options o;
+    memset(&o, 0, sizeof(o));
+    if (opts) o = *opts;
+    o.flags |= FM_OPT_STRING_KEYS;
+    return fm_init_ex(sizeof(fm_str_key), val_size, &o);
+}
+
+static inline void fm_put_str(_FastMap* map, const char* str, size_t len, const void* value) {
+    if (fm_needs_grow(map, 1)) fm_grow(map);
+    if (map->migrate_left > 0) fm_migrate_step(map, FM_MIGRATE_STEP);
+
+    fm_str_ref ref = { str, len, fm_hash(str, len) };
+    size_t idx = fm_lookup(map, &ref, ref.hash, NULL, NULL, sizeof(fm_str_key), fm_str_eq);
+    if (idx != FM_NPOS) {
+        memcpy(map->values.data + idx * map->val_size, value, map->val_size);
+        return;
+    }
+
+    // Intern only on insert; updates never touch the arena
+    fm_str_key k = fm_str_intern(map, str, len);
+    fm_append_entry(map, &k, value, ref.hash, sizeof(fm_str_key), map->val_size);
+}
+
+static inline void* fm_get_str(_FastMap* map, const char* str, size_t len) {
+    fm_str_ref ref = { str, len, fm_hash(str, len) };
+    return fm_get_impl(map, &ref, ref.hash, sizeof(fm_str_key), map->val_size, fm_str_eq);
+}
+
+static inline bool fm_erase_str(_FastMap* map, const char* str, size_t len) {
+    fm_str_ref ref = { str, len, fm_hash(str, len) };
+    return fm_erase_impl(map, &ref, ref.hash, sizeof(fm_str_key), map->val_size, fm_str_eq);
+}
+
+// Stored key at vector index 'idx' (not NUL-terminated)
+static inline const char* fm_key_str(const _FastMap* map, size_t idx, size_t* len) {
+    const fm_str_key* k = (const fm_str_key*)map->keys.data + idx;
+    if (len) *len = fm_str_len(k);
+    return fm_str_data(map, k);
+}
+
+// ----------------------------------------------------------------------------
+// GENERIC API
+// On string maps 'key' points to a NUL-terminated 'const char*', which is
+// what FM_PUT / FM_GET / FM_DELETE pass for a char* key type.
+// ----------------------------------------------------------------------------
+
+// Insert or Update
+static inline void fm_put(_FastMap* map, const void* key, const void* value) {
+    if (map->flags & FM_OPT_STRING_KEYS) {
+        const char* str = *(const char* const*)key;
+        fm_put_str(map, str, strlen(str), value);
+        return;
+    }
+
+    // 1. Check Load Factor
+    if (fm_needs_grow(map, 1)) fm_grow(map);
+
+    fm_put_impl(map, key, value, fm_map_hash(map, key), map->key_size, map->val_size, fm_key_eq_bytes);
+}
+
+// fm_put for callers that can shed load: returns false instead of
+// aborting when memory runs out. The map then holds what it held before
+// (its index may have grown).
+static inline bool fm_try_put(_FastMap* map, const void* key, const void* value) {
+    if (map->flags & FM_OPT_STRING_KEYS) {
+        const char* str = *(const char* const*)key;
+        size_t len = strlen(str);
+        if (!fm_try_prepare_insert(map, len > FM_STR_INLINE_MAX ? len : 0)) return false;
+        fm_put_str(map, str, len, value);
+        return true;
+    }
+
+    if (!fm_try_prepare_insert(map, 0)) return false;
+    fm_put_impl(map, key, value, fm_map_hash(map, key), map->key_size, map->val_size, fm_key_eq_bytes);
+    return true;
+}
+
+// Get Value
+static inline void* fm_get(_FastMap* map, const void* key) {
+    if (map->flags & FM_OPT_STRING_KEYS) {
+        const char* str = *(const char* const*)key;
+        return fm_get_str(map, str, strlen(str));
+    }
+    return fm_get_impl(map, key, fm_map_hash(map, key), map->key_size, map->val_size, fm_key_eq_bytes);
+}
+
+// The Delete Function
+static inline bool fm_erase(_FastMap* map, const void* key) {
+    if (map->flags & FM_OPT_STRING_KEYS) {
+        const char* str = *(const char* const*)key;
+        return fm_erase_str(map, str, strlen(str));
+    }
+    return fm_erase_impl(map, key, fm_map_hash(map, key), map->key_size, map->val_size, fm_key_eq_bytes);
+}
+
+// ============================================================================
+// SECTION 7: BATCHED OPERATIONS (Prefetch Pipelining)
+// ============================================================================
+
+// Keys are resolved FM_BATCH_WIDTH at a time in three stages: hash all and
+// prefetch each home bucket, then read the (now cached) buckets and prefetch
+// the referenced key/hash entries, then probe. The DRAM misses of independent
+// keys overlap instead of being paid one after another.
+#define FM_BATCH_WIDTH 32
+
+static inline void fm_prefetch(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr);
+#elif defined(FM_HAVE_SSE2)
+    _mm_prefetch((const char*)addr, _MM_HINT_T0);
+#else
+    (void)addr;
+#endif
+}
+
+// Stage 1: hash a chunk of contiguous keys and prefetch their home buckets
+static inline void fm_batch_hash(_FastMap* map, const unsigned char* keys, size_t n, uint64_t* hashes) {
+    const fm_table* t = &map->table;
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = fm_map_hash(map, keys + i * map->key_size);
+        if (t->bucket_count == 0) continue; // Small map: nothing to prefetch
+        size_t home = hashes[i] & t->bucket_mask;
+        if (t->slots) {
+            fm_prefetch(&t->slots[home]);
+        } else {
+            fm_prefetch((const char*)t->buckets + home * t->width);
+            if (t->ctrl) fm_prefetch(&t->ctrl[home]);
+        }
+    }
+}
+
+// Stage 2: follow each home bucket into the dense vectors
+static inline void fm_batch_prefetch_entries(_FastMap* map, size_t n, const uint64_t* hashes) {
+    const fm_table* t = &map->table;
+    if (t->bucket_count == 0) return;
+    for (size_t i = 0; i < n; i++) {
+        size_t home = hashes[i] & t->bucket_mask;
+        if (fm_slot_empty(t, home)) continue;
+        fm_index idx = fm_bucket_index(t, home);
+        fm_prefetch(fm_vec_at(&map->keys, idx));
+        if (!t->slots && fm_caches_hashes(map)) fm_prefetch((const uint64_t*)map->hashes.data + idx);
+    }
+}
+
+// Looks up 'n' contiguous keys; out[i] receives the value pointer or NULL
+static inline void fm_get_batch(_FastMap* map, const void* keys, size_t n, void** out) {
+    const unsigned char* k = (const unsigned char*)keys;
+    uint64_t hashes[FM_BATCH_WIDTH];
+
+    if (map->flags & FM_OPT_STRING_KEYS) { // 'keys' holds const char* pointers
+        for (size_t i = 0; i < n; i++) out[i] = fm_get(map, (const char* const*)keys + i);
+        return;
+    }
+
+    for (size_t base = 0; base < n; base += FM_BATCH_WIDTH) {
+        size_t count = n - base < FM_BATCH_WIDTH ? n - base : FM_BATCH_WIDTH;
+        const unsigned char* chunk = k + base * map->key_size;
+
+        fm_batch_hash(map, chunk, count, hashes);
+        fm_batch_prefetch_entries(map, count, hashes);
+
+        // Stage 3: resolve
+        for (size_t i = 0; i < count; i++) {
+            out[base + i] = fm_get_impl(map, chunk + i * map->key_size, hashes[i],
+                                        map->key_size, map->val_size, fm_key_eq_bytes);
+        }
+    }
+}
+
+// Inserts or updates 'n' contiguous key/value pairs
+static inline void fm_put_batch(_FastMap* map, const void* keys, const void* values, size_t n) {
+    const unsigned char* k = (const unsigned char*)keys;
+    const unsigned char* v = (const unsigned char*)values;
+    uint64_t hashes[FM_BATCH_WIDTH];
+
+    if (map->flags & FM_OPT_STRING_KEYS) {
+        for (size_t i = 0; i < n; i++) fm_put(map, (const char* const*)keys + i, v + i * map->val_size);
+        return;
+    }
+
+    for (size_t base = 0; base < n; base += FM_BATCH_WIDTH) {
+        size_t count = n - base < FM_BATCH_WIDTH ? n - base : FM_BATCH_WIDTH;
+
+        // Grow up front so the prefetched buckets are the ones we probe
+        while (fm_needs_grow(map, count)) fm_grow(map);
+
+        const unsigned char* chunk = k + base * map->key_size;
+        fm_batch_hash(map, chunk, count, hashes);
+        fm_batch_prefetch_entries(map, count, hashes);
+
+        for (size_t i = 0; i < count; i++) {
+            fm_put_impl(map, chunk + i * map->key_size, v + (base + i) * map->val_size, hashes[i],
+                        map->key_size, map->val_size, fm_key_eq_bytes);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// BULK BUILD
+// fm_build(map, keys, values, n, flags) loads n contiguous pairs into an
+// empty map without probing per element:
+//   1. hash every key (independent iterations, constant-size for 4/8/16)
+//   2. LSD radix sort (vector index, home bucket) pairs by home bucket
+//   3. with duplicates possible, compare equal hashes inside each home run;
+//      like repeated fm_put, the first position and the last value win
+//   4. copy the surviving entries into the dense vectors
+//   5. walk the sorted pairs and fill the index front to back. Linear
+//      probing in home order already is the Robin Hood layout, so no swaps
+//      happen; only entries wrapping past the last bucket go through the
+//      regular placement.
+// Non-empty and string-keyed maps fall back to fm_reserve + fm_put.
+// ----------------------------------------------------------------------------
+#define FM_BUILD_UNIQUE (1u << 0) // Caller guarantees the n keys are distinct
+
+#define FM_RADIX_BITS 11
+
+// Stable LSD radix sort of 'items' by their top 'bits' bits (home << 32 | idx)
+static inline void fm_radix_sort_homes(uint64_t* items, uint64_t* tmp, size_t n, uint32_t bits) {
+    size_t counts[1 << FM_RADIX_BITS];
+    for (uint32_t shift = 32; shift < 32 + bits; shift += FM_RADIX_BITS) {
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < n; i++) counts[(items[i] >> shift) & ((1 << FM_RADIX_BITS) - 1)]++;
+        size_t sum = 0;
+        for (size_t d = 0; d < (1 << FM_RADIX_BITS); d++) {
+            size_t c = counts[d];
+            counts[d] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++) tmp[counts[(items[i] >> shift) & ((1 << FM_RADIX_BITS) - 1)]++] = items[i];
+        uint64_t* swap = items; items = tmp; tmp = swap;
+    }
+    // An odd number of passes leaves the result in the scratch buffer
+    if (((bits + FM_RADIX_BITS - 1) / FM_RADIX_BITS) & 1) memcpy(tmp, items, n * sizeof(uint64_t));
+}
+
+static inline void fm_build_hashes(const _FastMap* map, const unsigned char* keys, size_t n, uint64_t* hashes) {
+    size_t key_size = map->key_size;
+    fm_hash_kind kind = map->hash_kind;
+    if (kind != FM_HASH_WY) {
+        for (size_t i = 0; i < n; i++) hashes[i] = fm_hash_as(kind, keys + i * key_size, key_size);
+        return;
+    }
+    switch (key_size) { // Constant sizes let fm_hash inline down to a few instructions
+        case 4:  for (size_t i = 0; i < n; i++) hashes[i] = fm_hash(keys + i * 4, 4); break;
+        case 8:  for (size_t i = 0; i < n; i++) hashes[i] = fm_hash(keys + i * 8, 8); break;
+        case 16: for (size_t i = 0; i < n; i++) hashes[i] = fm_hash(keys + i * 16, 16); break;
+        default: for (size_t i = 0; i < n; i++) hashes[i] = fm_hash(keys + i * key_size, key_size); break;
+    }
+}
+
+static inline void fm_build(_FastMap* map, const void* keys, const void* values, size_t n, uint32_t flags) {
+    const unsigned char* k = (const unsigned char*)keys;
+    const unsigned char* v = (const unsigned char*)values;
+    size_t ks = map->key_size, vs = map->val_size;
+
+    size_t bucket_count = 16;
+    while (n > bucket_count * map->max_load_factor) bucket_count *= 2;
+    if (map->keys.length > 0 || (map->flags & FM_OPT_STRING_KEYS) ||
+        (map->table.bucket_count == 0 && n <= FM_SMALL_MAX) || !fm_items_fit(n, bucket_count)) {
+        fm_reserve(map, map->keys.length + n);
+        for (size_t i = 0; i < n; i++) fm_put(map, k + i * ks, v + i * vs);
+        return;
+    }
+    if (n == 0) return;
+
+    // Size everything once; the rebuild of an empty map just allocates
+    if (map->table.bucket_count == 0 && !fm_small_try_promote(map)) abort(); // Handle OOM
+    if (!(map->flags & FM_OPT_FUSED)) { // A fused resize sizes the vectors too
+        fm_vec_reserve(&map->keys, n);
+        fm_vec_reserve(&map->values, n);
+        if (fm_caches_hashes(map)) fm_vec_reserve(&map->hashes, n);
+    }
+    fm_resize(map, bucket_count);
+    fm_table* t = &map->table;
+
+    const fm_allocator* alloc = map->allocator;
+    uint64_t* hashes = (uint64_t*)fm_mem_alloc(alloc, n * sizeof(uint64_t));
+    uint64_t* order = (uint64_t*)fm_mem_alloc(alloc, n * sizeof(uint64_t));
+    uint64_t* scratch = (uint64_t*)fm_mem_alloc(alloc, n * sizeof(uint64_t));
+    if (!hashes || !order || !scratch) abort(); // Handle OOM
+
+    // 1 + 2. Hash, then sort by home bucket
+    fm_build_hashes(map, k, n, hashes);
+    for (size_t i = 0; i < n; i++) order[i] = ((hashes[i] & t->bucket_mask) << 32) | i;
+    uint32_t bits = 0;
+    while (((size_t)1 << bits) < bucket_count) bits++;
+    fm_radix_sort_homes(order, scratch, n, bits);
+
+    // 3 + 4. Copy into the dense vectors
+    size_t count = n;
+    if (flags & FM_BUILD_UNIQUE) {
+        memcpy(map->keys.data, k, n * ks);
+        memcpy(map->values.data, v, n * vs);
+        if (fm_caches_hashes(map)) memcpy(map->hashes.data, hashes, n * sizeof(uint64_t));
+    } else {
+        // 'scratch' becomes the input -> dense index map (FM_ITEM_SKIP = dropped)
+        uint32_t* remap = (uint32_t*)scratch;
+        uint32_t* value_src = remap + n; // Fits: 'scratch' holds 2n uint32_t
+        for (size_t i = 0; i < n; i++) {
+            remap[i] = 0;
+            value_src[i] = (uint32_t)i;
+        }
+
+        for (size_t run = 0; run < n;) {
+            size_t end = run + 1;
+            while (end < n && (order[end] >> 32) == (order[run] >> 32)) end++;
+            for (size_t a = run; a < end; a++) {
+                uint32_t ia = (uint32_t)order[a];
+                if (remap[ia] == FM_ITEM_SKIP) continue;
+                for (size_t b = a + 1; b < end; b++) {
+                    uint32_t ib = (uint32_t)order[b];
+                    if (hashes[ib] == hashes[ia] && memcmp(k + (size_t)ib * ks, k + (size_t)ia * ks, ks) == 0) {
+                        remap[ib] = FM_ITEM_SKIP; // Stable sort: 'ib' is the later occurrence
+                        value_src[ia] = ib;
+                    }
+                }
             }
-            return true;
+            run = end;
         }
 
-        bucket_idx = (bucket_idx + 1) & map->bucket_mask;
-        dist++;
+        count = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (remap[i] == FM_ITEM_SKIP) continue;
+            memcpy(map->keys.data + count * ks, k + i * ks, ks);
+            memcpy(map->values.data + count * vs, v + (size_t)value_src[i] * vs, vs);
+            if (fm_caches_hashes(map)) ((uint64_t*)map->hashes.data)[count] = hashes[i];
+            remap[i] = (uint32_t)count++;
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint32_t idx = (uint32_t)order[i];
+            order[i] = (order[i] & ~(uint64_t)0xFFFFFFFF) | remap[idx];
+        }
+    }
+    map->keys.length = map->values.length = count;
+    map->hashes.length = fm_caches_hashes(map) ? count : 0;
+    FM_COUNT_N(map, inserts, count);
+
+    // 5. Fill the index in home order
+    size_t next = 0;
+    size_t done = fm_fill_sorted(map, t, order, NULL, n, &next, bucket_count);
+    if (done == FM_NPOS || !fm_place_items(map, t, order + done, n - done)) {
+        fm_resize(map, bucket_count * 2); // Packed distance byte exceeded
     }
+
+    fm_mem_free(alloc, hashes, n * sizeof(uint64_t));
+    fm_mem_free(alloc, order, n * sizeof(uint64_t));
+    fm_mem_free(alloc, scratch, n * sizeof(uint64_t));
 }
 
 // ============================================================================
-// SECTION 6: HELPERS, MACROS & API STRUCT
+// SECTION 8: STATISTICS
+// ============================================================================
+
+// Displacement histogram buckets; the last one collects everything beyond
+#define FM_STATS_HIST_LEN 32
+
+typedef struct {
+    size_t size;                 // Live entries
+    size_t bucket_count;         // Current table (plus 'old_bucket_count' while migrating)
+    size_t old_bucket_count;
+    double load_factor;          // size / bucket_count
+
+    // Robin Hood displacement (distance from the home bucket) of every entry.
+    // A hit probes displacement + 1 buckets, so mean_probe_length is the
+    // expected cost of a successful lookup.
+    size_t displacement_hist[FM_STATS_HIST_LEN];
+    uint32_t max_displacement;
+    double mean_probe_length;
+
+    // Heap bytes per component (capacity, not length)
+    size_t bytes_buckets;        // 'buckets', 'slots' and 'ctrl' of both tables
+    size_t bytes_keys;
+    size_t bytes_values;
+    size_t bytes_hashes;
+    size_t bytes_arena;
+    size_t bytes_total;
+    size_t bytes_wasted;         // Unused vector capacity plus erased arena strings
+
+    fm_counters counters;        // All zero unless FM_ENABLE_COUNTERS is defined
+} fm_stats_t;
+
+static inline size_t fm_table_bytes(const fm_table* t) {
+    if (t->bucket_count == 0) return 0;
+    if (t->slots) return t->bucket_count * sizeof(uint64_t);
+    return t->bucket_count * t->width + (t->ctrl ? t->bucket_count + FM_GROUP_WIDTH : 0);
+}
+
+static inline void fm_stats_walk(const _FastMap* map, const fm_table* t, fm_stats_t* out, uint64_t* dist_sum) {
+    for (size_t b = 0; b < t->bucket_count; b++) {
+        if (fm_slot_empty(t, b)) continue;
+        uint32_t dist = t->slots
+            ? fm_slot_dist(t->slots[b])
+            : (uint32_t)((b - fm_hash_at(map, fm_bucket_index(t, b))) & t->bucket_mask);
+        out->displacement_hist[dist < FM_STATS_HIST_LEN ? dist : FM_STATS_HIST_LEN - 1]++;
+        if (dist > out->max_displacement) out->max_displacement = dist;
+        *dist_sum += dist;
+    }
+}
+
+// Walks the index and the cached hashes. O(bucket_count); meant for
+// diagnostics, not hot paths.
+static inline void fm_stats(const _FastMap* map, fm_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+    out->size = map->keys.length;
+    out->bucket_count = map->table.bucket_count;
+    out->old_bucket_count = map->old_table.bucket_count;
+    out->load_factor = out->bucket_count ? (double)out->size / (double)out->bucket_count : 0.0;
+
+    uint64_t dist_sum = 0;
+    fm_stats_walk(map, &map->table, out, &dist_sum);
+    if (map->migrate_left > 0) fm_stats_walk(map, &map->old_table, out, &dist_sum);
+    out->mean_probe_length = out->size ? 1.0 + (double)dist_sum / (double)out->size : 0.0;
+
+    out->bytes_buckets = fm_table_bytes(&map->table) + fm_table_bytes(&map->old_table);
+    out->bytes_keys = map->keys.capacity * map->keys.stride;
+    out->bytes_values = map->values.capacity * map->values.stride;
+    out->bytes_hashes = map->hashes.capacity * map->hashes.stride;
+    out->bytes_arena = map->arena.capacity;
+    out->bytes_total = out->bytes_buckets + out->bytes_keys + out->bytes_values + out->bytes_hashes + out->bytes_arena;
+    if ((map->flags & FM_OPT_FUSED) || map->table.bucket_count == 0) {
+        out->bytes_total = fm_fused_bytes(map) + out->bytes_arena; // Plus padding
+    }
+
+    size_t spare = map->keys.capacity - map->keys.length;
+    out->bytes_wasted = spare * (map->keys.stride + map->values.stride + (fm_caches_hashes(map) ? map->hashes.stride : 0)) +
+                        (map->arena.capacity - map->arena.length);
+    if (map->flags & FM_OPT_STRING_KEYS) {
+        size_t live = 0;
+        const fm_str_key* k = (const fm_str_key*)map->keys.data;
+        for (size_t i = 0; i < map->keys.length; i++) {
+            if (k[i].small.len == FM_STR_IN_ARENA) live += k[i].big.len;
+        }
+        out->bytes_wasted += map->arena.length - live; // Strings of erased keys
+    }
+
+    out->counters = map->counters;
+}
+
+// ============================================================================
+// SECTION 9: HELPERS, MACROS & API STRUCT
 // ============================================================================
 
 // Helper to initialize map with types
 // _FastMap map = FM_INIT(int, float);
 #define FM_INIT(K, V) fm_init(sizeof(K), sizeof(V))
 
+// String-keyed map (content hashing, see fm_put_str)
+// _FastMap map = FM_INIT_STR(int);
+#define FM_INIT_STR(V) fm_init_str(sizeof(V), NULL)
+
 // Helper to put literals
 // FM_PUT(&map, int, 10, float, 55.5f);
 #define FM_PUT(map_ptr, KType, k, VType, v) do { \
@@ -481,6 +2697,63 @@ static inline bool fm_erase(_FastMap* map, const void* key) {
 #define FM_DELETE(map_ptr, KType, k) \
     fm_erase((map_ptr), &((KType){k}))
 
+// ----------------------------------------------------------------------------
+// TYPED MAPS
+// FM_DECLARE(IntMap, int, float, fm_hash_int, int_eq) emits:
+//   IntMap IntMap_init(void);              IntMap IntMap_init_ex(const fm_options*);
+//   void   IntMap_put(IntMap*, int, float); bool   IntMap_try_put(IntMap*, int, float);
+//   float* IntMap_get(IntMap*, int);        bool   IntMap_erase(IntMap*, int);
+//   size_t IntMap_size(const IntMap*);      void   IntMap_reserve(IntMap*, size_t);
+//   void   IntMap_free(IntMap*);
+// 'hash_fn' is uint64_t(K) and 'eq_fn' is bool(K, K). Key and value sizes
+// are compile-time constants and both functions are inlined into the probe
+// loops. The cached hashes come from 'hash_fn', so the generic fm_* calls
+// must not be used on the embedded 'base' map.
+// ----------------------------------------------------------------------------
+#define FM_DECLARE(Name, K, V, hash_fn, eq_fn) \
+    typedef struct { _FastMap base; } Name; \
+    \
+    static inline bool Name##_key_eq_(const _FastMap* map, const void* stored, const void* probe) { \
+        (void)map; \
+        return eq_fn(*(const K*)stored, *(const K*)probe); \
+    } \
+    static inline Name Name##_init_ex(const fm_options* opts) { \
+        Name m; \
+        fm_options o; \
+        memset(&o, 0, sizeof(o)); \
+        if (opts) o = *opts; \
+        o.flags &= ~FM_OPT_NO_HASH_CACHE; /* fm_hash_at would use fm_hash */ \
+        m.base = fm_init_ex(sizeof(K), sizeof(V), &o); \
+        return m; \
+    } \
+    static inline Name Name##_init(void) { \
+        return Name##_init_ex(NULL); \
+    } \
+    static inline void Name##_free(Name* m) { \
+        fm_free(&m->base); \
+    } \
+    static inline size_t Name##_size(const Name* m) { \
+        return m->base.keys.length; \
+    } \
+    static inline void Name##_reserve(Name* m, size_t n) { \
+        fm_reserve(&m->base, n); \
+    } \
+    static inline void Name##_put(Name* m, K key, V value) { \
+        if (fm_needs_grow(&m->base, 1)) fm_grow(&m->base); \
+        fm_put_impl(&m->base, &key, &value, hash_fn(key), sizeof(K), sizeof(V), Name##_key_eq_); \
+    } \
+    static inline bool Name##_try_put(Name* m, K key, V value) { \
+        if (!fm_try_prepare_insert(&m->base, 0)) return false; \
+        fm_put_impl(&m->base, &key, &value, hash_fn(key), sizeof(K), sizeof(V), Name##_key_eq_); \
+        return true; \
+    } \
+    static inline V* Name##_get(Name* m, K key) { \
+        return (V*)fm_get_impl(&m->base, &key, hash_fn(key), sizeof(K), sizeof(V), Name##_key_eq_); \
+    } \
+    static inline bool Name##_erase(Name* m, K key) { \
+        return fm_erase_impl(&m->base, &key, hash_fn(key), sizeof(K), sizeof(V), Name##_key_eq_); \
+    }
+
 // ----------------------------------------------------------------------------
 // THE 'fm' NAMESPACE STRUCT
 // Allows syntax like: fm.put(&map, &key, &val);
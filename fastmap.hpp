@@ -0,0 +1,501 @@
+#ifndef FASTMAP_HPP
+#define FASTMAP_HPP
+
+// ============================================================================
+// fastmap::dense_map<K, V, Hash, Eq, Alloc> (C++17, header-only)
+//
+// The same design as the C map in fastmap.h: dense keys / values / hashes
+// vectors plus a sparse Robin Hood index of fm_index positions. Unlike the
+// void* API it works with move-only and non-trivial types (elements are
+// moved on growth and on swap-and-pop erase), and the hash and equality are
+// compiled into the probe loop.
+// ============================================================================
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fastmap.h"
+
+namespace fastmap {
+
+// ============================================================================
+// SECTION 1: HASHING
+// ============================================================================
+
+// Default hasher. Scalars are hashed as raw bytes with fm_hash, strings by
+// content (transparently, so std::string maps accept std::string_view and
+// const char* lookups). Anything else goes through std::hash and is mixed
+// by the map, because std::hash is often the identity.
+template <class K, class = void>
+struct hash {
+    uint64_t operator()(const K& key) const noexcept {
+        return static_cast<uint64_t>(std::hash<K>{}(key));
+    }
+};
+
+template <class K>
+struct hash<K, std::enable_if_t<std::is_integral_v<K> || std::is_enum_v<K> || std::is_pointer_v<K>>> {
+    using is_avalanching = void;
+    uint64_t operator()(const K& key) const noexcept {
+        return fm_hash(&key, sizeof(K));
+    }
+};
+
+struct string_hash {
+    using is_transparent = void;
+    using is_avalanching = void;
+    uint64_t operator()(std::string_view s) const noexcept {
+        return fm_hash(s.data(), s.size());
+    }
+};
+
+template <> struct hash<std::string> : string_hash {};
+template <> struct hash<std::string_view> : string_hash {};
+
+namespace detail {
+
+template <class T, class = void> struct is_transparent : std::false_type {};
+template <class T> struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
+
+template <class T, class = void> struct is_avalanching : std::false_type {};
+template <class T> struct is_avalanching<T, std::void_t<typename T::is_avalanching>> : std::true_type {};
+
+} // namespace detail
+
+// ============================================================================
+// SECTION 2: THE MAP
+// ============================================================================
+
+template <class K,
+          class V,
+          class Hash = hash<K>,
+          class Eq = std::equal_to<>,
+          class Alloc = std::allocator<std::pair<const K, V>>>
+class dense_map {
+    template <class T>
+    using rebind = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+
+    static constexpr fm_index EMPTY_IDX = FM_EMPTY_IDX; // 64-bit with FM_INDEX_64
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+    static constexpr size_t MIN_BUCKETS = 16;
+
+    static constexpr bool transparent = detail::is_transparent<Hash>::value && detail::is_transparent<Eq>::value;
+
+    template <class Q>
+    using if_transparent = std::enable_if_t<transparent && !std::is_same_v<std::decay_t<Q>, K>, int>;
+
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using size_type = size_t;
+    using hasher = Hash;
+    using key_equal = Eq;
+    using allocator_type = Alloc;
+
+    // Entries are split across two vectors, so iterators hand out a pair of
+    // references rather than a std::pair stored in the map.
+    template <bool Const>
+    class basic_iterator {
+        using map_ptr = std::conditional_t<Const, const dense_map*, dense_map*>;
+        using value_ref = std::conditional_t<Const, const V&, V&>;
+
+    public:
+        struct reference {
+            const K& first;
+            value_ref second;
+        };
+        struct pointer {
+            reference ref;
+            const reference* operator->() const { return &ref; }
+        };
+        using value_type = reference;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_iterator() = default;
+        basic_iterator(map_ptr map, size_t idx) : map_(map), idx_(idx) {}
+        template <bool C = Const, std::enable_if_t<C, int> = 0>
+        basic_iterator(const basic_iterator<false>& other) : map_(other.map_), idx_(other.idx_) {}
+
+        reference operator*() const { return { map_->keys_[idx_], map_->values_[idx_] }; }
+        pointer operator->() const { return { **this }; }
+        basic_iterator& operator++() { ++idx_; return *this; }
+        basic_iterator operator++(int) { basic_iterator t = *this; ++idx_; return t; }
+        bool operator==(const basic_iterator& o) const { return idx_ == o.idx_; }
+        bool operator!=(const basic_iterator& o) const { return idx_ != o.idx_; }
+
+        size_t index() const { return idx_; } // Position in the dense vectors
+
+    private:
+        friend class dense_map;
+        map_ptr map_ = nullptr;
+        size_t idx_ = 0;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    // --- Construction ---
+
+    dense_map() = default;
+
+    explicit dense_map(size_t expected, const Hash& h = Hash(), const Eq& eq = Eq(), const Alloc& alloc = Alloc())
+        : keys_(rebind<K>(alloc)), values_(rebind<V>(alloc)), hashes_(rebind<uint64_t>(alloc)),
+          buckets_(rebind<fm_index>(alloc)), hash_(h), eq_(eq) {
+        reserve(expected);
+    }
+
+    dense_map(const dense_map&) = default;
+    dense_map& operator=(const dense_map&) = default;
+
+    dense_map(dense_map&& other) noexcept
+        : keys_(std::move(other.keys_)), values_(std::move(other.values_)), hashes_(std::move(other.hashes_)),
+          buckets_(std::move(other.buckets_)), mask_(other.mask_), max_load_(other.max_load_),
+          hash_(std::move(other.hash_)), eq_(std::move(other.eq_)) {
+        other.reset_moved_from();
+    }
+
+    dense_map& operator=(dense_map&& other) noexcept {
+        if (this != &other) {
+            keys_ = std::move(other.keys_);
+            values_ = std::move(other.values_);
+            hashes_ = std::move(other.hashes_);
+            buckets_ = std::move(other.buckets_);
+            mask_ = other.mask_;
+            max_load_ = other.max_load_;
+            hash_ = std::move(other.hash_);
+            eq_ = std::move(other.eq_);
+            other.reset_moved_from();
+        }
+        return *this;
+    }
+
+    // --- Capacity ---
+
+    size_t size() const noexcept { return keys_.size(); }
+    bool empty() const noexcept { return keys_.empty(); }
+    size_t bucket_count() const noexcept { return buckets_.size(); }
+    float load_factor() const noexcept { return buckets_.empty() ? 0.0f : (float)size() / (float)buckets_.size(); }
+    float max_load_factor() const noexcept { return max_load_; }
+    void max_load_factor(float ml) { max_load_ = ml; reserve(size()); }
+
+    // Sizes the index and the dense vectors for 'n' entries in one step
+    void reserve(size_t n) {
+        keys_.reserve(n);
+        values_.reserve(n);
+        hashes_.reserve(n);
+        size_t want = MIN_BUCKETS;
+        while (want * max_load_ < (double)n) want *= 2;
+        if (want > buckets_.size()) rehash_to(want);
+    }
+
+    void clear() noexcept {
+        keys_.clear();
+        values_.clear();
+        hashes_.clear();
+        std::fill(buckets_.begin(), buckets_.end(), EMPTY_IDX);
+    }
+
+    // --- Iteration (dense order) ---
+
+    iterator begin() noexcept { return { this, 0 }; }
+    iterator end() noexcept { return { this, size() }; }
+    const_iterator begin() const noexcept { return { this, 0 }; }
+    const_iterator end() const noexcept { return { this, size() }; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    // Direct access to the dense storage
+    const std::vector<K, rebind<K>>& keys() const noexcept { return keys_; }
+    const std::vector<V, rebind<V>>& values() const noexcept { return values_; }
+
+    // --- Lookup ---
+
+    iterator find(const K& key) { return { this, index_of(key) }; }
+    const_iterator find(const K& key) const { return { this, index_of(key) }; }
+    bool contains(const K& key) const { return find_index(key, hash_key(key)) != NPOS; }
+    size_t count(const K& key) const { return contains(key) ? 1 : 0; }
+
+    template <class Q, if_transparent<Q> = 0>
+    iterator find(const Q& key) { return { this, index_of(key) }; }
+    template <class Q, if_transparent<Q> = 0>
+    const_iterator find(const Q& key) const { return { this, index_of(key) }; }
+    template <class Q, if_transparent<Q> = 0>
+    bool contains(const Q& key) const { return find_index(key, hash_key(key)) != NPOS; }
+    template <class Q, if_transparent<Q> = 0>
+    size_t count(const Q& key) const { return contains(key) ? 1 : 0; }
+
+    V& at(const K& key) { return at_impl(key); }
+    const V& at(const K& key) const { return const_cast<dense_map*>(this)->at_impl(key); }
+    template <class Q, if_transparent<Q> = 0>
+    V& at(const Q& key) { return at_impl(key); }
+    template <class Q, if_transparent<Q> = 0>
+    const V& at(const Q& key) const { return const_cast<dense_map*>(this)->at_impl(key); }
+
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+    V& operator[](K&& key) { return try_emplace(std::move(key)).first->second; }
+
+    // --- Modifiers ---
+
+    // Constructs V from 'args' only if 'key' is absent. One probe locates
+    // either the key or the Robin Hood insertion point.
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+        return emplace_impl(key, std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        return emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+    template <class Q, class... Args, if_transparent<Q> = 0>
+    std::pair<iterator, bool> try_emplace(Q&& key, Args&&... args) {
+        return emplace_impl(std::forward<Q>(key), std::forward<Args>(args)...);
+    }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& obj) {
+        return assign_impl(key, std::forward<M>(obj));
+    }
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(K&& key, M&& obj) {
+        return assign_impl(std::move(key), std::forward<M>(obj));
+    }
+    template <class Q, class M, if_transparent<Q> = 0>
+    std::pair<iterator, bool> insert_or_assign(Q&& key, M&& obj) {
+        return assign_impl(std::forward<Q>(key), std::forward<M>(obj));
+    }
+
+    std::pair<iterator, bool> insert(const std::pair<K, V>& kv) { return try_emplace(kv.first, kv.second); }
+    std::pair<iterator, bool> insert(std::pair<K, V>&& kv) { return try_emplace(std::move(kv.first), std::move(kv.second)); }
+
+    size_t erase(const K& key) { return erase_impl(key); }
+    template <class Q, if_transparent<Q> = 0>
+    size_t erase(const Q& key) { return erase_impl(key); }
+
+    // Swap-and-pop: the last entry moves into 'pos', so the returned
+    // iterator (same position) visits it next.
+    iterator erase(const_iterator pos) {
+        size_t idx = pos.idx_;
+        erase_bucket(bucket_of_index(idx));
+        return { this, idx };
+    }
+
+    void swap(dense_map& other) noexcept {
+        using std::swap;
+        swap(keys_, other.keys_);
+        swap(values_, other.values_);
+        swap(hashes_, other.hashes_);
+        swap(buckets_, other.buckets_);
+        swap(mask_, other.mask_);
+        swap(max_load_, other.max_load_);
+        swap(hash_, other.hash_);
+        swap(eq_, other.eq_);
+    }
+
+private:
+    // ========================================================================
+    // INTERNAL LOGIC (Robin Hood over an fm_index array)
+    // ========================================================================
+
+    template <class Q>
+    uint64_t hash_key(const Q& key) const {
+        uint64_t h = static_cast<uint64_t>(hash_(key));
+        if constexpr (!detail::is_avalanching<Hash>::value) {
+            h = fm_wymix(h ^ 0x9E3779B97F4A7C15ULL, 0xbf58476d1ce4e5b9ULL); // Spread weak hashes
+        }
+        return h;
+    }
+
+    size_t dist_of(size_t bucket, uint64_t hash) const { return (bucket - hash) & mask_; }
+
+    // Vector index of 'key', or NPOS. The cached hash is compared before the key.
+    template <class Q>
+    size_t find_index(const Q& key, uint64_t hash) const {
+        if (keys_.empty()) return NPOS;
+        size_t bucket = hash & mask_;
+        for (size_t dist = 0;; dist++, bucket = (bucket + 1) & mask_) {
+            fm_index idx = buckets_[bucket];
+            if (idx == EMPTY_IDX) return NPOS;
+            uint64_t h = hashes_[idx];
+            if (dist_of(bucket, h) < dist) return NPOS; // Robin Hood early exit
+            if (h == hash && eq_(keys_[idx], key)) return idx;
+        }
+    }
+
+    template <class Q>
+    size_t index_of(const Q& key) const {
+        size_t idx = find_index(key, hash_key(key));
+        return idx == NPOS ? size() : idx;
+    }
+
+    template <class Q>
+    V& at_impl(const Q& key) {
+        size_t idx = find_index(key, hash_key(key));
+        if (idx == NPOS) throw std::out_of_range("fastmap::dense_map::at");
+        return values_[idx];
+    }
+
+    // Robin Hood placement of 'idx' starting at 'bucket' with distance 'dist'
+    void place_from(size_t bucket, size_t dist, fm_index idx) {
+        while (true) {
+            fm_index existing = buckets_[bucket];
+            if (existing == EMPTY_IDX) {
+                buckets_[bucket] = idx;
+                return;
+            }
+            size_t existing_dist = dist_of(bucket, hashes_[existing]);
+            if (existing_dist < dist) {
+                buckets_[bucket] = idx; // Steal from the rich
+                idx = existing;
+                dist = existing_dist;
+            }
+            bucket = (bucket + 1) & mask_;
+            dist++;
+        }
+    }
+
+    void rehash_to(size_t bucket_count) {
+        buckets_.assign(bucket_count, EMPTY_IDX);
+        mask_ = bucket_count - 1;
+        for (size_t i = 0; i < hashes_.size(); i++) {
+            place_from(hashes_[i] & mask_, 0, static_cast<fm_index>(i));
+        }
+    }
+
+    bool needs_grow() const {
+        return buckets_.empty() || (double)(size() + 1) > (double)buckets_.size() * max_load_;
+    }
+
+    template <class KK, class... Args>
+    std::pair<iterator, bool> emplace_impl(KK&& key, Args&&... args) {
+        uint64_t hash = hash_key(key);
+
+        while (true) {
+            size_t bucket = hash & mask_;
+            size_t dist = 0;
+
+            // One probe: stop on the key, an empty bucket, or a richer resident
+            if (!buckets_.empty()) {
+                for (;; dist++, bucket = (bucket + 1) & mask_) {
+                    fm_index idx = buckets_[bucket];
+                    if (idx == EMPTY_IDX) break;
+                    uint64_t h = hashes_[idx];
+                    if (dist_of(bucket, h) < dist) break;
+                    if (h == hash && eq_(keys_[idx], key)) return { iterator(this, idx), false };
+                }
+            }
+
+            // Growing moves the insertion point; only then is the probe repeated
+            if (needs_grow()) {
+                rehash_to(buckets_.empty() ? MIN_BUCKETS : buckets_.size() * 2);
+                continue;
+            }
+
+            if (size() >= EMPTY_IDX) throw std::length_error("fastmap::dense_map: too many entries");
+            fm_index new_idx = static_cast<fm_index>(size());
+            // The hash goes first, so a throw at any step pops what was pushed
+            // and the three vectors stay the same length
+            hashes_.push_back(hash);
+            try {
+                keys_.emplace_back(std::forward<KK>(key));
+            } catch (...) {
+                hashes_.pop_back();
+                throw;
+            }
+            try {
+                values_.emplace_back(std::forward<Args>(args)...);
+            } catch (...) {
+                keys_.pop_back();
+                hashes_.pop_back();
+                throw;
+            }
+            place_from(bucket, dist, new_idx);
+            return { iterator(this, new_idx), true };
+        }
+    }
+
+    template <class KK, class M>
+    std::pair<iterator, bool> assign_impl(KK&& key, M&& obj) {
+        auto result = emplace_impl(std::forward<KK>(key), std::forward<M>(obj));
+        if (!result.second) values_[result.first.idx_] = std::forward<M>(obj);
+        return result;
+    }
+
+    // Bucket holding vector index 'idx' (probed via its cached hash)
+    size_t bucket_of_index(size_t idx) const {
+        size_t bucket = hashes_[idx] & mask_;
+        while (buckets_[bucket] != idx) bucket = (bucket + 1) & mask_;
+        return bucket;
+    }
+
+    template <class Q>
+    size_t erase_impl(const Q& key) {
+        size_t idx = find_index(key, hash_key(key));
+        if (idx == NPOS) return 0;
+        erase_bucket(bucket_of_index(idx));
+        return 1;
+    }
+
+    // Swap-and-Pop from the vectors, then Backshift in the index
+    void erase_bucket(size_t bucket) {
+        fm_index idx = buckets_[bucket];
+        fm_index last = static_cast<fm_index>(size() - 1);
+
+        if (idx != last) {
+            buckets_[bucket_of_index(last)] = idx;
+            keys_[idx] = std::move(keys_[last]);
+            values_[idx] = std::move(values_[last]);
+            hashes_[idx] = hashes_[last];
+        }
+        keys_.pop_back();
+        values_.pop_back();
+        hashes_.pop_back();
+
+        size_t hole = bucket;
+        while (true) {
+            size_t next = (hole + 1) & mask_;
+            fm_index next_idx = buckets_[next];
+            if (next_idx == EMPTY_IDX || dist_of(next, hashes_[next_idx]) == 0) {
+                buckets_[hole] = EMPTY_IDX;
+                return;
+            }
+            buckets_[hole] = next_idx;
+            hole = next;
+        }
+    }
+
+    void reset_moved_from() noexcept {
+        keys_.clear();
+        values_.clear();
+        hashes_.clear();
+        buckets_.clear();
+        mask_ = 0;
+    }
+
+    std::vector<K, rebind<K>> keys_;
+    std::vector<V, rebind<V>> values_;
+    std::vector<uint64_t, rebind<uint64_t>> hashes_;
+    std::vector<fm_index, rebind<fm_index>> buckets_;
+    size_t mask_ = 0;
+    float max_load_ = 0.80f;
+    Hash hash_;
+    Eq eq_;
+};
+
+template <class K, class V, class H, class E, class A>
+void swap(dense_map<K, V, H, E, A>& a, dense_map<K, V, H, E, A>& b) noexcept {
+    a.swap(b);
+}
+
+} // namespace fastmap
+
+#endif // FASTMAP_HPP
@@ -0,0 +1,800 @@
+#ifndef FASTMAP_CONCURRENT_H
+#define FASTMAP_CONCURRENT_H
+
+// ============================================================================
+// fm_concurrent: a sharded, thread-safe wrapper around _FastMap
+//
+// Keys are routed to one of N (power of two) shards, each an ordinary
+// _FastMap behind its own lock on its own cache lines. Every operation
+// takes exactly one shard lock, so threads working on different shards
+// never contend and no operation can deadlock.
+//
+// The default lock is a POSIX reader-writer lock: compile with
+// _POSIX_C_SOURCE >= 200112L (or -std=gnu11) and -pthread. Define
+// FM_CONCURRENT_SPINLOCK for a C11-atomics spinlock instead, which suits
+// very short critical sections on dedicated cores (readers then exclude
+// each other too).
+//
+// Keys are fixed-size byte keys (FM_OPT_STRING_KEYS is not supported).
+// Pointers into a shard are only valid under its lock, which is why reads
+// copy the value out (fm_concurrent_get_copy) and in-place changes go
+// through a callback (fm_concurrent_update).
+//
+// fm_seqmap (further down) is the single-writer alternative for read-mostly
+// maps: readers take no lock at all. fm_cmap is an insert-only map for
+// parallel ingestion and dedup: CAS instead of locks, no erase.
+// ============================================================================
+
+#include "fastmap.h"
+
+#include <stdatomic.h>
+#if !defined(FM_CONCURRENT_SPINLOCK)
+    #include <pthread.h>
+#endif
+#if defined(FM_HAVE_PTHREADS)
+    #include <sched.h>
+#endif
+
+#define FM_CACHE_LINE 64
+#define FM_CONCURRENT_DEFAULT_SHARDS 64
+
+// Shards are picked by hash bits 32..39: above any bucket mask a shard
+// will realistically use, and below the bits the control-byte tags (57+)
+// and packed fingerprints (40+) are taken from, so routing does not make
+// every key in a shard share its tag.
+#define FM_SHARD_BIT_SHIFT 32
+#define FM_CONCURRENT_MAX_SHARDS 256
+
+// ----------------------------------------------------------------------------
+// LOCKS
+// ----------------------------------------------------------------------------
+
+#if defined(FM_CONCURRENT_SPINLOCK)
+typedef atomic_flag fm_lock;
+
+static inline void fm_lock_init(fm_lock* l) { atomic_flag_clear(l); }
+static inline void fm_lock_destroy(fm_lock* l) { (void)l; }
+
+static inline void fm_lock_write(fm_lock* l) {
+    while (atomic_flag_test_and_set_explicit(l, memory_order_acquire)) {
+#if defined(FM_HAVE_SSE2)
+        _mm_pause();
+#endif
+    }
+}
+static inline void fm_lock_read(fm_lock* l) { fm_lock_write(l); }
+static inline void fm_unlock(fm_lock* l) { atomic_flag_clear_explicit(l, memory_order_release); }
+#else
+typedef pthread_rwlock_t fm_lock;
+
+static inline void fm_lock_init(fm_lock* l) {
+    if (pthread_rwlock_init(l, NULL) != 0) abort();
+}
+static inline void fm_lock_destroy(fm_lock* l) { pthread_rwlock_destroy(l); }
+static inline void fm_lock_write(fm_lock* l) { pthread_rwlock_wrlock(l); }
+static inline void fm_unlock(fm_lock* l) { pthread_rwlock_unlock(l); }
+
+// With FM_ENABLE_COUNTERS a lookup writes the shard's counters, so
+// readers must exclude each other too
+static inline void fm_lock_read(fm_lock* l) {
+#if defined(FM_ENABLE_COUNTERS)
+    pthread_rwlock_wrlock(l);
+#else
+    pthread_rwlock_rdlock(l);
+#endif
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// MAP
+// ----------------------------------------------------------------------------
+
+// Each shard starts on its own cache line (and its size rounds up to whole
+// lines), so no two shards' locks or maps share a line
+typedef struct {
+    _Alignas(FM_CACHE_LINE) fm_lock lock;
+    _FastMap map;
+} fm_shard;
+
+typedef struct {
+    fm_shard* shards;
+    size_t shard_mask;   // shard count - 1
+    size_t key_size;
+    size_t val_size;
+    fm_hash_kind hash_kind; // Shared by every shard: routing hashes once
+    void* zero_value;    // val_size zero bytes, the start value for fm_concurrent_update
+} fm_concurrent;
+
+// Called under the shard's write lock with the key's value slot; 'existed'
+// is false when the key was just inserted with a zeroed value
+typedef void (*fm_update_fn)(void* value, bool existed, void* user);
+
+// 'shards' is rounded up to a power of two (0 picks the default); 'opts'
+// applies to every shard, so an opts->allocator is called from every
+// thread that holds a shard lock and must be thread-safe
+static inline fm_concurrent fm_concurrent_init(size_t key_size, size_t val_size, size_t shards, const fm_options* opts) {
+    if (opts && (opts->flags & FM_OPT_STRING_KEYS)) abort(); // Not supported, see above
+    if (shards == 0) shards = FM_CONCURRENT_DEFAULT_SHARDS;
+    if (shards > FM_CONCURRENT_MAX_SHARDS) shards = FM_CONCURRENT_MAX_SHARDS;
+    size_t count = 1;
+    while (count < shards) count *= 2;
+
+    fm_concurrent c;
+    c.shard_mask = count - 1;
+    c.key_size = key_size;
+    c.val_size = val_size;
+    c.zero_value = calloc(1, val_size ? val_size : 1);
+    c.shards = (fm_shard*)aligned_alloc(FM_CACHE_LINE, count * sizeof(fm_shard));
+    if (!c.zero_value || !c.shards) abort(); // Handle OOM
+
+    for (size_t i = 0; i < count; i++) {
+        fm_lock_init(&c.shards[i].lock);
+        c.shards[i].map = fm_init_ex(key_size, val_size, opts);
+    }
+    c.hash_kind = c.shards[0].map.hash_kind;
+    return c;
+}
+
+// Not thread-safe: no other thread may be using the map
+static inline void fm_concurrent_free(fm_concurrent* c) {
+    for (size_t i = 0; i <= c->shard_mask; i++) {
+        fm_lock_destroy(&c->shards[i].lock);
+        fm_free(&c->shards[i].map);
+    }
+    free(c->shards);
+    free(c->zero_value);
+    c->shards = NULL;
+}
+
+static inline fm_shard* fm_concurrent_shard(const fm_concurrent* c, uint64_t hash) {
+    return &c->shards[(hash >> FM_SHARD_BIT_SHIFT) & c->shard_mask];
+}
+
+// Insert or Update
+static inline void fm_concurrent_put(fm_concurrent* c, const void* key, const void* value) {
+    uint64_t hash = fm_hash_as(c->hash_kind, key, c->key_size);
+    fm_shard* s = fm_concurrent_shard(c, hash);
+
+    fm_lock_write(&s->lock);
+    if (fm_needs_grow(&s->map, 1)) fm_grow(&s->map);
+    fm_put_impl(&s->map, key, value, hash, c->key_size, c->val_size, fm_key_eq_bytes);
+    fm_unlock(&s->lock);
+}
+
+// Copies the value into 'out' (val_size bytes); false if the key is absent
+static inline bool fm_concurrent_get_copy(fm_concurrent* c, const void* key, void* out) {
+    uint64_t hash = fm_hash_as(c->hash_kind, key, c->key_size);
+    fm_shard* s = fm_concurrent_shard(c, hash);
+
+    fm_lock_read(&s->lock);
+    void* value = fm_get_impl(&s->map, key, hash, c->key_size, c->val_size, fm_key_eq_bytes);
+    if (value) memcpy(out, value, c->val_size);
+    fm_unlock(&s->lock);
+    return value != NULL;
+}
+
+static inline bool fm_concurrent_erase(fm_concurrent* c, const void* key) {
+    uint64_t hash = fm_hash_as(c->hash_kind, key, c->key_size);
+    fm_shard* s = fm_concurrent_shard(c, hash);
+
+    fm_lock_write(&s->lock);
+    bool erased = fm_erase_impl(&s->map, key, hash, c->key_size, c->val_size, fm_key_eq_bytes);
+    fm_unlock(&s->lock);
+    return erased;
+}
+
+// Read-modify-write of one value: inserts the key with a zeroed value if
+// absent, then runs 'fn' on it under the shard lock. 'fn' must not call
+// back into the map. Returns whether the key existed.
+static inline bool fm_concurrent_update(fm_concurrent* c, const void* key, fm_update_fn fn, void* user) {
+    uint64_t hash = fm_hash_as(c->hash_kind, key, c->key_size);
+    fm_shard* s = fm_concurrent_shard(c, hash);
+    _FastMap* map = &s->map;
+
+    fm_lock_write(&s->lock);
+    if (map->migrate_left > 0) fm_migrate_step(map, FM_MIGRATE_STEP);
+    size_t idx = fm_lookup(map, key, hash, NULL, NULL, c->key_size, fm_key_eq_bytes);
+    bool existed = idx != FM_NPOS;
+    if (!existed) {
+        if (fm_needs_grow(map, 1)) fm_grow(map);
+        idx = map->keys.length;
+        fm_append_entry(map, key, c->zero_value, hash, c->key_size, c->val_size);
+    }
+    fn(map->values.data + idx * c->val_size, existed, user);
+    fm_unlock(&s->lock);
+    return existed;
+}
+
+// Sum of the shard sizes, taking one shard lock at a time: exact only when
+// no writers are running
+static inline size_t fm_concurrent_size(fm_concurrent* c) {
+    size_t total = 0;
+    for (size_t i = 0; i <= c->shard_mask; i++) {
+        fm_lock_read(&c->shards[i].lock);
+        total += c->shards[i].map.keys.length;
+        fm_unlock(&c->shards[i].lock);
+    }
+    return total;
+}
+
+// ----------------------------------------------------------------------------
+// SINGLE WRITER, LOCK-FREE READERS (fm_seqmap)
+// fm_seqmap* m = fm_seqmap_create(sizeof(K), sizeof(V), NULL);
+// writer thread:  fm_seqmap_put(m, &k, &v);   fm_seqmap_erase(m, &k);
+// reader threads: fm_seq_reader r = fm_seqmap_reader(m);
+//                 if (fm_seqmap_get_copy(&r, &k, &v)) ...
+//                 fm_seqmap_reader_release(&r);
+//
+// The writer updates a plain _FastMap inside a seqlock: 'seq' is odd while
+// an update is in flight. Readers write nothing shared but their own slot.
+// They probe, copy the value out and retry if 'seq' moved meanwhile, so a
+// read that raced a put, an erase's swap-and-pop or a resize is discarded.
+// Memory a reader may still be probing (a table replaced by a resize,
+// vectors replaced when they grow) is retired instead of freed and
+// reclaimed after an epoch-based grace period. The vectors never shrink,
+// so everything a racing reader touches stays mapped.
+//
+// The writer must be a single thread (or serialize its calls). Packed
+// buckets and incremental resize are not supported: both can drop a table
+// from inside a put. Neither are the fused and small layouts, which free
+// the vectors and the index together, or compact indices and dropped hash
+// caches (the racy probe reads full-width buckets and cached hashes).
+// fm_options.allocator is not supported either: retired memory goes back
+// to libc.
+// ----------------------------------------------------------------------------
+
+#define FM_SEQ_MAX_READERS 256
+
+// The reader probe races the writer by design and relies on the sequence
+// check; keep it out of ThreadSanitizer's view
+#if defined(__GNUC__) || defined(__clang__)
+    #define FM_SEQ_RACY __attribute__((no_sanitize("thread")))
+#else
+    #define FM_SEQ_RACY
+#endif
+
+typedef struct {
+    _Alignas(FM_CACHE_LINE) _Atomic uint64_t epoch; // Epoch the current read began in; 0 while idle
+    atomic_bool claimed;
+} fm_reader_slot;
+
+typedef struct {
+    void* ptr;
+    uint64_t epoch; // Global epoch when it was unpublished
+} fm_retired;
+
+typedef struct {
+    _Alignas(FM_CACHE_LINE) _Atomic uint64_t seq; // Odd while the writer is mid-update
+    _Atomic uint64_t epoch;                          // Advanced by each reclaim pass
+    _Alignas(FM_CACHE_LINE) _FastMap map;            // Mutated by the writer only
+    fm_vector retired;                               // fm_retired, writer only
+    fm_reader_slot readers[FM_SEQ_MAX_READERS];
+} fm_seqmap;
+
+typedef struct {
+    fm_seqmap* m;
+    fm_reader_slot* slot;
+} fm_seq_reader;
+
+static inline fm_seqmap* fm_seqmap_create(size_t key_size, size_t val_size, const fm_options* opts) {
+    if (opts && ((opts->flags & (FM_OPT_STRING_KEYS | FM_OPT_PACKED_BUCKETS | FM_OPT_INCREMENTAL | FM_OPT_FUSED | FM_OPT_SMALL |
+                  FM_OPT_COMPACT_INDEX | FM_OPT_NO_HASH_CACHE)) ||
+                 opts->allocator)) {
+        abort(); // Not supported, see above
+    }
+    fm_seqmap* m = (fm_seqmap*)aligned_alloc(FM_CACHE_LINE, sizeof(fm_seqmap));
+    if (!m) abort(); // Handle OOM
+
+    atomic_init(&m->seq, 0);
+    atomic_init(&m->epoch, 1);
+    m->map = fm_init_ex(key_size, val_size, opts);
+    fm_vec_init(&m->retired, sizeof(fm_retired), 0, NULL);
+    for (size_t i = 0; i < FM_SEQ_MAX_READERS; i++) {
+        atomic_init(&m->readers[i].epoch, 0);
+        atomic_init(&m->readers[i].claimed, false);
+    }
+    return m;
+}
+
+// Not thread-safe: every reader must be released first
+static inline void fm_seqmap_destroy(fm_seqmap* m) {
+    fm_retired* items = (fm_retired*)m->retired.data;
+    for (size_t i = 0; i < m->retired.length; i++) free(items[i].ptr);
+    fm_vec_free(&m->retired);
+    fm_free(&m->map);
+    free(m);
+}
+
+// --- Writer side ---
+
+static inline void fm_seq_write_begin(fm_seqmap* m) {
+    uint64_t s = atomic_load_explicit(&m->seq, memory_order_relaxed);
+    atomic_store_explicit(&m->seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void fm_seq_write_end(fm_seqmap* m) {
+    uint64_t s = atomic_load_explicit(&m->seq, memory_order_relaxed);
+    atomic_store_explicit(&m->seq, s + 1, memory_order_release);
+}
+
+static inline void fm_seq_retire(fm_seqmap* m, void* ptr) {
+    if (!ptr) return;
+    fm_retired r = { ptr, atomic_load_explicit(&m->epoch, memory_order_relaxed) };
+    fm_vec_push(&m->retired, &r);
+}
+
+// Frees what no reader can still see. Bumping the epoch after the pointers
+// were unpublished means a reader announcing the new epoch cannot load
+// them; anything retired before the oldest announced epoch is unreachable.
+static inline void fm_seq_reclaim(fm_seqmap* m) {
+    if (m->retired.length == 0) return;
+    atomic_fetch_add_explicit(&m->epoch, 1, memory_order_seq_cst);
+
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < FM_SEQ_MAX_READERS; i++) {
+        uint64_t e = atomic_load_explicit(&m->readers[i].epoch, memory_order_seq_cst);
+        if (e != 0 && e < oldest) oldest = e;
+    }
+
+    fm_retired* items = (fm_retired*)m->retired.data;
+    size_t kept = 0;
+    for (size_t i = 0; i < m->retired.length; i++) {
+        if (items[i].epoch < oldest) free(items[i].ptr);
+        else items[kept++] = items[i];
+    }
+    m->retired.length = kept;
+}
+
+// Makes room for 'extra' more entries without freeing anything a reader
+// may hold. Each replacement is published pointers first, bounds second
+// (capacities, bucket mask), so a reader that sees a new bound also sees
+// the buffer it belongs to.
+static inline void fm_seqmap_reserve(fm_seqmap* m, size_t extra) {
+    _FastMap* map = &m->map;
+    size_t need = map->keys.length + extra;
+
+    if (need > map->keys.capacity) {
+        size_t cap = map->keys.capacity * 2;
+        while (cap < need) cap *= 2;
+        fm_vector* vecs[3] = { &map->keys, &map->values, &map->hashes };
+        unsigned char* fresh[3];
+        unsigned char* old[3];
+        for (int i = 0; i < 3; i++) {
+            fresh[i] = (unsigned char*)malloc(cap * vecs[i]->stride);
+            if (!fresh[i]) abort(); // Handle OOM
+            memcpy(fresh[i], vecs[i]->data, vecs[i]->length * vecs[i]->stride);
+        }
+        fm_seq_write_begin(m);
+        for (int i = 0; i < 3; i++) {
+            old[i] = vecs[i]->data;
+            vecs[i]->data = fresh[i];
+        }
+        atomic_thread_fence(memory_order_release);
+        for (int i = 0; i < 3; i++) vecs[i]->capacity = cap;
+        fm_seq_write_end(m);
+        for (int i = 0; i < 3; i++) fm_seq_retire(m, old[i]);
+    }
+
+    if (fm_needs_grow(map, extra)) {
+        FM_COUNT(map, resizes);
+        size_t buckets = map->table.bucket_count * 2;
+        while (need > buckets * map->max_load_factor) buckets *= 2;
+        fm_table fresh = fm_rebuild_table(map, buckets); // Reads only: no need to exclude readers
+        fm_table old = map->table;
+
+        fm_seq_write_begin(m);
+        map->table.buckets = fresh.buckets;
+        map->table.ctrl = fresh.ctrl;
+        atomic_thread_fence(memory_order_release);
+        map->table.bucket_count = fresh.bucket_count;
+        map->table.bucket_mask = fresh.bucket_mask;
+        fm_seq_write_end(m);
+        fm_seq_retire(m, old.buckets);
+        fm_seq_retire(m, old.ctrl);
+    }
+    fm_seq_reclaim(m);
+}
+
+static inline void fm_seqmap_put(fm_seqmap* m, const void* key, const void* value) {
+    _FastMap* map = &m->map;
+    uint64_t hash = fm_map_hash(map, key);
+    fm_seqmap_reserve(m, 1);
+
+    fm_seq_write_begin(m);
+    fm_put_impl(map, key, value, hash, map->key_size, map->val_size, fm_key_eq_bytes);
+    fm_seq_write_end(m);
+}
+
+static inline bool fm_seqmap_erase(fm_seqmap* m, const void* key) {
+    _FastMap* map = &m->map;
+    uint64_t hash = fm_map_hash(map, key);
+    // The writer is the only mutator, so a miss needs no write section
+    if (fm_get_impl(map, key, hash, map->key_size, map->val_size, fm_key_eq_bytes) == NULL) return false;
+
+    fm_seq_write_begin(m);
+    fm_erase_impl(map, key, hash, map->key_size, map->val_size, fm_key_eq_bytes);
+    fm_seq_write_end(m);
+    return true;
+}
+
+// --- Reader side ---
+
+// Claims a reader slot; one per reading thread, held across many reads
+static inline fm_seq_reader fm_seqmap_reader(fm_seqmap* m) {
+    for (size_t i = 0; i < FM_SEQ_MAX_READERS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&m->readers[i].claimed, &expected, true)) {
+            fm_seq_reader r = { m, &m->readers[i] };
+            return r;
+        }
+    }
+    abort(); // More than FM_SEQ_MAX_READERS readers
+}
+
+static inline void fm_seqmap_reader_release(fm_seq_reader* r) {
+    atomic_store_explicit(&r->slot->claimed, false, memory_order_release);
+    r->slot = NULL;
+}
+
+// One unvalidated probe over the plain bucket array (the ctrl-byte layout
+// keeps it too). Torn state can only make it miss or match a stale entry,
+// never index outside a live or retired buffer: bounds are read before the
+// pointers they guard and every index is checked against the capacity.
+FM_SEQ_RACY static inline bool fm_seq_probe(const _FastMap* map, const void* key, uint64_t hash, void* out) {
+    size_t mask = map->table.bucket_mask;
+    size_t cap = map->keys.capacity;
+    atomic_thread_fence(memory_order_acquire);
+    const fm_index* buckets = map->table.buckets;
+    const unsigned char* keys = map->keys.data;
+    const unsigned char* values = map->values.data;
+    const uint64_t* hashes = (const uint64_t*)map->hashes.data;
+
+    size_t pos = hash & mask;
+    for (size_t dist = 0; dist <= mask; dist++) {
+        fm_index idx = buckets[pos];
+        if (idx == FM_EMPTY_IDX || idx >= cap) return false;
+        uint64_t h = hashes[idx];
+        if (h == hash && fm_key_eq_bytes(map, keys + idx * map->key_size, key)) {
+            memcpy(out, values + idx * map->val_size, map->val_size);
+            return true;
+        }
+        if (((pos - (h & mask)) & mask) < dist) return false; // Robin Hood early exit
+        pos = (pos + 1) & mask;
+    }
+    return false;
+}
+
+// Copies the value into 'out' (val_size bytes, scratch on a miss); false if
+// the key is absent. Wait-free unless the writer is mid-update.
+static inline bool fm_seqmap_get_copy(fm_seq_reader* r, const void* key, void* out) {
+    fm_seqmap* m = r->m;
+    uint64_t hash = fm_map_hash(&m->map, key);
+
+    // Announce the epoch before touching any pointer (see fm_seq_reclaim)
+    atomic_store_explicit(&r->slot->epoch, atomic_load_explicit(&m->epoch, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    bool found;
+    while (true) {
+        uint64_t s = atomic_load_explicit(&m->seq, memory_order_acquire);
+        if (s & 1) {
+#if defined(FM_HAVE_SSE2)
+            _mm_pause();
+#endif
+            continue;
+        }
+        found = fm_seq_probe(&m->map, key, hash, out);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&m->seq, memory_order_relaxed) == s) break;
+    }
+
+    atomic_store_explicit(&r->slot->epoch, 0, memory_order_release);
+    return found;
+}
+
+// ----------------------------------------------------------------------------
+// INSERT-ONLY, LOCK-FREE (fm_cmap)
+// fm_cmap* m = fm_cmap_create(sizeof(K), sizeof(V), expected);
+// any thread: if (fm_cmap_insert(m, &k, &v, &idx)) ... (false: key was there)
+//             const V* p = fm_cmap_get(m, &k);
+//
+// A grow-only map for parallel ingestion. An inserter reserves a dense
+// record with one fetch-add on the length, writes key and value there,
+// then claims a bucket with a CAS from empty to its index. Probing is
+// linear without Robin Hood swaps, so a claimed bucket never changes and
+// a published index always points at a complete record. Records live in
+// segments that double in size and never move, so pointers returned by
+// fm_cmap_get stay valid until fm_cmap_destroy.
+//
+// Buckets are 64-bit: the low 32 hash bits above the index. Probes only
+// touch a record when those match, and migration never touches one.
+//
+// Growth is cooperative. Once the head table passes the load limit a
+// twice-as-large 'next' table is attached, and every inserter that
+// arrives migrates chunks of buckets until none are left to hand out.
+// Migrating a bucket freezes it (sets FM_CMAP_FROZEN, or turns an empty
+// bucket into FM_CMAP_FROZEN_EMPTY) and copies the index into 'next'; a
+// frozen bucket can no longer be claimed. Inserts only go into the head
+// table, so an inserter that runs out of chunks to take waits for the
+// ones still held by other threads. That wait is the one place a
+// descheduled thread can hold the others up. Readers never wait: they
+// follow FM_CMAP_FROZEN_EMPTY into 'next'. Retired tables are kept until
+// destroy; together they are smaller than the live one.
+//
+// A record reserved by an inserter that then loses the race to an equal
+// key stays in the dense storage, but is not live (see fm_cmap_at).
+// ----------------------------------------------------------------------------
+
+#define FM_CMAP_EMPTY        UINT64_MAX
+#define FM_CMAP_FROZEN_EMPTY (UINT64_MAX - 1) // Empty bucket closed by migration
+#define FM_CMAP_FROZEN       0x80000000u      // Bucket migrated to 'next' (its entry is kept)
+#define FM_CMAP_MAX_ENTRIES  0x7FFFFFFEu
+#define FM_CMAP_SEGMENT0_BITS 10         // Records in the first segment: 1024, then doubling
+#define FM_CMAP_SEGMENTS     22
+#define FM_CMAP_CHUNK        4096        // Buckets per migration task
+#define FM_CMAP_MIN_BUCKETS  FM_CMAP_CHUNK
+
+typedef struct fm_ctable {
+    _Atomic uint64_t* buckets; // hash << 32 | index (| FM_CMAP_FROZEN)
+    size_t mask;
+    _Atomic(struct fm_ctable*) next;   // Set once this table is being migrated
+    _Atomic size_t migrate_cursor;     // Next chunk to hand out
+    _Atomic size_t migrate_done;       // Chunks fully copied into 'next'
+} fm_ctable;
+
+// Record header; the key and value follow, each padded to 8 bytes
+typedef struct {
+    _Atomic uint32_t live; // Set once the record's index is in a bucket
+    uint32_t pad;
+} fm_crec;
+
+typedef struct {
+    _Alignas(FM_CACHE_LINE) _Atomic size_t length;   // Records reserved
+    _Alignas(FM_CACHE_LINE) _Atomic(fm_ctable*) head; // Oldest table still being read
+    _Atomic size_t wasted;                            // Reserved records that lost to an equal key
+    fm_ctable* first;                                 // Start of the table chain, for destroy
+    size_t key_size;
+    size_t val_size;
+    size_t key_offset;
+    size_t val_offset;
+    size_t stride;
+    _Atomic(unsigned char*) segments[FM_CMAP_SEGMENTS];
+} fm_cmap;
+
+static inline fm_ctable* fm_ctable_new(size_t bucket_count) {
+    fm_ctable* t = (fm_ctable*)malloc(sizeof(fm_ctable));
+    uint64_t* buckets = (uint64_t*)malloc(bucket_count * sizeof(uint64_t));
+    if (!t || !buckets) abort(); // Handle OOM
+    memset(buckets, 0xFF, bucket_count * sizeof(uint64_t)); // FM_CMAP_EMPTY
+    t->buckets = (_Atomic uint64_t*)buckets;
+    t->mask = bucket_count - 1;
+    atomic_init(&t->next, NULL);
+    atomic_init(&t->migrate_cursor, 0);
+    atomic_init(&t->migrate_done, 0);
+    return t;
+}
+
+static inline size_t fm_cmap_round8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+static inline fm_cmap* fm_cmap_create(size_t key_size, size_t val_size, size_t expected) {
+    fm_cmap* m = (fm_cmap*)aligned_alloc(FM_CACHE_LINE, sizeof(fm_cmap));
+    if (!m) abort(); // Handle OOM
+    m->key_size = key_size;
+    m->val_size = val_size;
+    m->key_offset = sizeof(fm_crec);
+    m->val_offset = m->key_offset + fm_cmap_round8(key_size);
+    m->stride = m->val_offset + fm_cmap_round8(val_size);
+
+    size_t buckets = FM_CMAP_MIN_BUCKETS;
+    while (expected > buckets / 2) buckets *= 2; // Room to stay under the load limit
+    m->first = fm_ctable_new(buckets);
+    atomic_init(&m->head, m->first);
+    atomic_init(&m->length, 0);
+    atomic_init(&m->wasted, 0);
+    for (size_t i = 0; i < FM_CMAP_SEGMENTS; i++) atomic_init(&m->segments[i], NULL);
+    return m;
+}
+
+// Not thread-safe: every inserter and reader must be done
+static inline void fm_cmap_destroy(fm_cmap* m) {
+    for (fm_ctable* t = m->first; t;) {
+        fm_ctable* next = atomic_load_explicit(&t->next, memory_order_relaxed);
+        free((void*)t->buckets);
+        free(t);
+        t = next;
+    }
+    for (size_t i = 0; i < FM_CMAP_SEGMENTS; i++) free(atomic_load_explicit(&m->segments[i], memory_order_relaxed));
+    free(m);
+}
+
+static inline uint32_t fm_log2_32(uint32_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long r; _BitScanReverse(&r, x); return (uint32_t)r;
+#else
+    return 31 - (uint32_t)__builtin_clz(x);
+#endif
+}
+
+// Record 'idx' lives in segment floor(log2(idx / 1024 + 1)). Without
+// 'alloc', NULL if that segment was never allocated.
+static inline unsigned char* fm_cmap_record(fm_cmap* m, size_t idx, bool alloc) {
+    uint32_t seg = fm_log2_32((uint32_t)(idx >> FM_CMAP_SEGMENT0_BITS) + 1);
+    size_t base = (((size_t)1 << seg) - 1) << FM_CMAP_SEGMENT0_BITS;
+
+    unsigned char* data = atomic_load_explicit(&m->segments[seg], memory_order_acquire);
+    if (!data && alloc) {
+        unsigned char* fresh = (unsigned char*)calloc((size_t)1 << (FM_CMAP_SEGMENT0_BITS + seg), m->stride);
+        if (!fresh) abort(); // Handle OOM
+        if (atomic_compare_exchange_strong(&m->segments[seg], &data, fresh)) data = fresh;
+        else free(fresh); // Another inserter got there first; 'data' is theirs
+    }
+    if (!data) return NULL;
+    return data + (idx - base) * m->stride;
+}
+
+// Whether occupied bucket 'b' (frozen or not) holds 'key'
+static inline bool fm_cmap_matches(fm_cmap* m, uint64_t b, const void* key, uint64_t hash) {
+    if ((uint32_t)(b >> 32) != (uint32_t)hash) return false;
+    const unsigned char* rec = fm_cmap_record(m, (uint32_t)b & ~FM_CMAP_FROZEN, false);
+    return memcmp(rec + m->key_offset, key, m->key_size) == 0;
+}
+
+// Claims the first empty bucket for an entry known to be absent from 't'
+static inline void fm_ctable_place(fm_ctable* t, uint64_t entry) {
+    for (size_t pos = (entry >> 32) & t->mask;; pos = (pos + 1) & t->mask) {
+        uint64_t expected = FM_CMAP_EMPTY;
+        if (atomic_compare_exchange_strong(&t->buckets[pos], &expected, entry)) return;
+    }
+}
+
+// Copies chunks of 'old' into its successor until none are left to hand
+// out. Whoever finishes the last chunk makes the successor the head.
+static inline void fm_cmap_help_migrate(fm_cmap* m, fm_ctable* old) {
+    fm_ctable* next = atomic_load_explicit(&old->next, memory_order_acquire);
+    size_t chunks = (old->mask + 1) / FM_CMAP_CHUNK;
+
+    while (true) {
+        size_t c = atomic_fetch_add(&old->migrate_cursor, 1);
+        if (c >= chunks) return;
+
+        for (size_t pos = c * FM_CMAP_CHUNK; pos < (c + 1) * FM_CMAP_CHUNK; pos++) {
+            uint64_t b = atomic_load_explicit(&old->buckets[pos], memory_order_acquire);
+            while (b == FM_CMAP_EMPTY || !(b & FM_CMAP_FROZEN)) {
+                uint64_t frozen = b == FM_CMAP_EMPTY ? FM_CMAP_FROZEN_EMPTY : (b | FM_CMAP_FROZEN);
+                if (atomic_compare_exchange_strong(&old->buckets[pos], &b, frozen)) {
+                    if (b != FM_CMAP_EMPTY) fm_ctable_place(next, b);
+                    break;
+                }
+            }
+        }
+        if (atomic_fetch_add(&old->migrate_done, 1) + 1 == chunks) {
+            atomic_store_explicit(&m->head, next, memory_order_release);
+        }
+    }
+}
+
+// Attaches a successor to the head table (once; losers free theirs)
+static inline void fm_cmap_grow(fm_cmap* m, fm_ctable* t) {
+    if (atomic_load_explicit(&m->head, memory_order_acquire) != t) return; // Previous growth still migrating
+    if (atomic_load_explicit(&t->next, memory_order_acquire)) return;
+    fm_ctable* fresh = fm_ctable_new((t->mask + 1) * 2);
+    fm_ctable* expected = NULL;
+    if (!atomic_compare_exchange_strong(&t->next, &expected, fresh)) {
+        free((void*)fresh->buckets);
+        free(fresh);
+    }
+}
+
+// Migrates what is left of 'old' and waits for chunks other threads hold,
+// so that inserts only ever land in the head table
+static inline fm_ctable* fm_cmap_finish_migration(fm_cmap* m, fm_ctable* old) {
+    fm_cmap_help_migrate(m, old);
+    size_t chunks = (old->mask + 1) / FM_CMAP_CHUNK;
+    while (atomic_load_explicit(&old->migrate_done, memory_order_acquire) != chunks) {
+#if defined(FM_HAVE_PTHREADS)
+        sched_yield(); // The holder may be descheduled
+#elif defined(FM_HAVE_SSE2)
+        _mm_pause();
+#endif
+    }
+    return atomic_load_explicit(&old->next, memory_order_acquire);
+}
+
+// Inserts the key unless an equal one is present. Either way '*idx_out'
+// (if non-NULL) receives the index of the record holding the key, usable
+// with fm_cmap_at. Returns true if this call inserted it.
+static inline bool fm_cmap_insert(fm_cmap* m, const void* key, const void* value, size_t* idx_out) {
+    uint64_t hash = fm_hash(key, m->key_size);
+    uint32_t mine = UINT32_MAX; // Our record, reserved at the first empty bucket
+    fm_ctable* t = atomic_load_explicit(&m->head, memory_order_acquire);
+
+    while (true) {
+        if (atomic_load_explicit(&t->next, memory_order_acquire)) {
+            t = fm_cmap_finish_migration(m, t);
+            continue;
+        }
+
+        size_t pos = hash & t->mask;
+        while (true) {
+            uint64_t b = atomic_load_explicit(&t->buckets[pos], memory_order_acquire);
+            if (b == FM_CMAP_EMPTY) {
+                if (mine == UINT32_MAX) {
+                    size_t idx = atomic_fetch_add_explicit(&m->length, 1, memory_order_relaxed);
+                    if (idx >= FM_CMAP_MAX_ENTRIES) abort(); // Index space exhausted
+                    unsigned char* rec = fm_cmap_record(m, idx, true);
+                    memcpy(rec + m->key_offset, key, m->key_size);
+                    memcpy(rec + m->val_offset, value, m->val_size);
+                    mine = (uint32_t)idx;
+                }
+                if (atomic_compare_exchange_strong(&t->buckets[pos], &b, (hash << 32) | mine)) {
+                    atomic_store_explicit(&((fm_crec*)fm_cmap_record(m, mine, false))->live, 1, memory_order_release);
+                    if (mine >= (t->mask + 1) / 4 * 3) fm_cmap_grow(m, t); // Load limit 0.75
+                    if (idx_out) *idx_out = mine;
+                    return true;
+                }
+                // Lost the bucket: an inserter (look at its key) or a migrator (move on)
+            }
+            if (b & FM_CMAP_FROZEN) {
+                // Being migrated. A frozen match is still a match: the key is
+                // in every later table too.
+                if (b == FM_CMAP_FROZEN_EMPTY || !fm_cmap_matches(m, b, key, hash)) break;
+            } else if (!fm_cmap_matches(m, b, key, hash)) {
+                pos = (pos + 1) & t->mask;
+                continue;
+            }
+            uint32_t idx = (uint32_t)b & ~FM_CMAP_FROZEN;
+            fm_crec* found = (fm_crec*)fm_cmap_record(m, idx, false);
+            if (!atomic_load_explicit(&found->live, memory_order_relaxed)) {
+                atomic_store_explicit(&found->live, 1, memory_order_release); // Winner may not have got to it yet
+            }
+            if (mine != UINT32_MAX) atomic_fetch_add_explicit(&m->wasted, 1, memory_order_relaxed);
+            if (idx_out) *idx_out = idx;
+            return false;
+        }
+    }
+}
+
+// Value of 'key', or NULL. The pointer stays valid until fm_cmap_destroy.
+static inline const void* fm_cmap_get(fm_cmap* m, const void* key) {
+    uint64_t hash = fm_hash(key, m->key_size);
+    fm_ctable* t = atomic_load_explicit(&m->head, memory_order_acquire);
+    size_t pos = hash & t->mask;
+
+    while (true) {
+        uint64_t b = atomic_load_explicit(&t->buckets[pos], memory_order_acquire);
+        if (b == FM_CMAP_EMPTY) return NULL;
+        if (b == FM_CMAP_FROZEN_EMPTY) {
+            t = atomic_load_explicit(&t->next, memory_order_acquire);
+            pos = hash & t->mask;
+            continue;
+        }
+        if (fm_cmap_matches(m, b, key, hash)) {
+            return fm_cmap_record(m, (uint32_t)b & ~FM_CMAP_FROZEN, false) + m->val_offset;
+        }
+        pos = (pos + 1) & t->mask;
+    }
+}
+
+// Records reserved so far: indices for fm_cmap_at
+static inline size_t fm_cmap_reserved(fm_cmap* m) {
+    return atomic_load_explicit(&m->length, memory_order_acquire);
+}
+
+// Distinct keys inserted (exact once inserters are done)
+static inline size_t fm_cmap_size(fm_cmap* m) {
+    return fm_cmap_reserved(m) - atomic_load_explicit(&m->wasted, memory_order_relaxed);
+}
+
+// Key and value of record 'idx' (below fm_cmap_reserved); false if the
+// record never became live
+static inline bool fm_cmap_at(fm_cmap* m, size_t idx, const void** key, const void** value) {
+    unsigned char* rec = fm_cmap_record(m, idx, false);
+    if (rec == NULL || !atomic_load_explicit(&((fm_crec*)rec)->live, memory_order_acquire)) return false;
+    if (key) *key = rec + m->key_offset;
+    if (value) *value = rec + m->val_offset;
+    return true;
+}
+
+#endif // FASTMAP_CONCURRENT_H
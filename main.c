@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <time.h>
+#define FM_ENABLE_COUNTERS // Exercised by test_stats
 #include "fastmap.h"
 
 // ============================================================================
@@ -26,6 +27,20 @@ typedef struct {
     float x, y, z;
 } Vec3;
 
+typedef struct {
+    uint32_t a, b, c, d;
+} Key16;
+
+static inline bool int_eq(int a, int b) { return a == b; }
+
+static inline uint64_t key16_hash(Key16 k) { return fm_hash(&k, sizeof(k)); }
+static inline bool key16_eq(Key16 x, Key16 y) {
+    return x.a == y.a && x.b == y.b && x.c == y.c && x.d == y.d;
+}
+
+FM_DECLARE(IntFloatMap, int, float, fm_hash_int, int_eq)
+FM_DECLARE(Key16Map, Key16, Vec3, key16_hash, key16_eq)
+
 // ============================================================================
 // TEST CASES
 // ============================================================================
@@ -69,8 +84,8 @@ void test_basic_int_map() {
 }
 
 void test_string_keys() {
-    // Key is char* (pointer), Value is int
-    _FastMap map = FM_INIT(char*, int);
+    // Key is char* (hashed by content), Value is int
+    _FastMap map = FM_INIT_STR(int);
 
     // Use const char* for string literals
     const char* k1 = "apple";
@@ -101,6 +116,57 @@ void test_string_keys() {
     LOG_PASS("String Content Hashing");
 }
 
+static void exercise_string_map(const fm_options* opts) {
+    _FastMap map = fm_init_str(sizeof(int), opts);
+    char buf[64];
+
+    // Mix of inline (<= 15 bytes) and arena-stored keys
+    for (int i = 0; i < 20000; i++) {
+        int len = snprintf(buf, sizeof(buf), (i % 2) ? "k%d" : "a-much-longer-identifier-%d", i);
+        fm_put_str(&map, buf, (size_t)len, &i);
+    }
+    ASSERT_EQ((size_t)20000, map.keys.length, "%zu");
+
+    for (int i = 0; i < 20000; i++) {
+        int len = snprintf(buf, sizeof(buf), (i % 2) ? "k%d" : "a-much-longer-identifier-%d", i);
+        int* val = (int*)fm_get_str(&map, buf, (size_t)len);
+        assert(val != NULL);
+        ASSERT_EQ(i, *val, "%d");
+    }
+
+    // Lookup by (ptr, len) into a larger buffer: no NUL terminator needed
+    const char* text = "k1k3k5";
+    ASSERT_EQ(3, *(int*)fm_get_str(&map, text + 2, 2), "%d");
+    assert(fm_get_str(&map, text, 3) == NULL); // "k1k"
+    assert(fm_get_str(&map, "", 0) == NULL);
+
+    // Erase half, stored keys stay readable through fm_key_str
+    for (int i = 0; i < 20000; i += 2) {
+        int len = snprintf(buf, sizeof(buf), "a-much-longer-identifier-%d", i);
+        assert(fm_erase_str(&map, buf, (size_t)len));
+    }
+    ASSERT_EQ((size_t)10000, map.keys.length, "%zu");
+    for (size_t idx = 0; idx < map.keys.length; idx++) {
+        size_t len;
+        const char* key = fm_key_str(&map, idx, &len);
+        int val = *(int*)fm_vec_at(&map.values, idx);
+        int n = snprintf(buf, sizeof(buf), "k%d", val);
+        ASSERT_EQ((size_t)n, len, "%zu");
+        assert(memcmp(key, buf, len) == 0);
+    }
+
+    fm_free(&map);
+}
+
+void test_string_arena() {
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS, FM_OPT_INCREMENTAL };
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+        fm_options opts = { .flags = layouts[i] };
+        exercise_string_map(&opts);
+    }
+    LOG_PASS("String Arena Keys");
+}
+
 void test_struct_values() {
     _FastMap map = FM_INIT(int, Vec3);
 
@@ -179,14 +245,1006 @@ void test_massive_resize() {
     LOG_PASS("Massive Resize & Collision Handling");
 }
 
+// Insert / erase / lookup workload shared by the alternative bucket layouts
+static void exercise_int_map(_FastMap* map) {
+    int COUNT = 50000;
+    for (int i = 0; i < COUNT; i++) {
+        FM_PUT(map, int, i * 7, int, i);
+    }
+    assert(map->keys.length == (size_t)COUNT);
+
+    // Erase every other key; swap-and-pop and backshift must keep buckets in sync
+    for (int i = 0; i < COUNT; i += 2) {
+        assert(FM_DELETE(map, int, i * 7));
+    }
+    assert(map->keys.length == (size_t)COUNT / 2);
+
+    for (int i = 0; i < COUNT; i++) {
+        int* val = FM_GET(map, int, i * 7);
+        if (i % 2 == 0) {
+            assert(val == NULL);
+        } else {
+            assert(val != NULL && *val == i);
+        }
+    }
+
+    // Misses that never collide with a stored key
+    for (int i = 0; i < COUNT; i++) {
+        assert(FM_GET(map, int, i * 7 + 1) == NULL);
+    }
+}
+
+void test_ctrl_bytes() {
+    fm_options opts = { .flags = FM_OPT_CTRL_BYTES };
+    _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+
+    exercise_int_map(&map);
+
+    fm_free(&map);
+    LOG_PASS("Control Bytes (SIMD Group Probing)");
+}
+
+void test_packed_buckets() {
+    fm_options opts = { .flags = FM_OPT_PACKED_BUCKETS };
+    _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+
+    exercise_int_map(&map);
+
+    // Every occupied slot must carry its entry's true distance and fingerprint
+    fm_table* t = &map.table;
+    for (size_t b = 0; b < t->bucket_count; b++) {
+        uint64_t slot = t->slots[b];
+        if (slot == FM_SLOT_EMPTY) continue;
+        uint64_t h = *(uint64_t*)fm_vec_at(&map.hashes, (uint32_t)slot);
+        size_t dist = (b + t->bucket_count - (h & t->bucket_mask)) & t->bucket_mask;
+        assert(slot == fm_slot_make((uint32_t)slot, h, (uint32_t)dist));
+    }
+
+    // A chain longer than the distance byte is refused (caller then grows)
+    uint64_t* slots = (uint64_t*)calloc(512, sizeof(uint64_t));
+    bool placed = true;
+    uint32_t n = 0;
+    while (placed) placed = fm_place_slot(slots, 511, 42, n++);
+    assert(n == FM_SLOT_MAX_DIST + 2);
+    free(slots);
+
+    fm_free(&map);
+    LOG_PASS("Packed Buckets (Fingerprint + Distance)");
+}
+
+void test_batch_api() {
+    _FastMap map = FM_INIT(int, int);
+
+    int COUNT = 10000;
+    int* keys = (int*)malloc(COUNT * 2 * sizeof(int));
+    int* vals = (int*)malloc(COUNT * sizeof(int));
+    void** out = (void**)malloc(COUNT * 2 * sizeof(void*));
+
+    for (int i = 0; i < COUNT; i++) {
+        keys[i] = i * 3;
+        vals[i] = i;
+    }
+    fm_put_batch(&map, keys, vals, COUNT);
+    assert(map.keys.length == (size_t)COUNT);
+
+    // Updates through the batch path must not duplicate keys
+    for (int i = 0; i < COUNT; i++) vals[i] = -i;
+    fm_put_batch(&map, keys, vals, COUNT);
+    assert(map.keys.length == (size_t)COUNT);
+
+    // Interleave hits and misses
+    for (int i = 0; i < COUNT * 2; i++) keys[i] = (i % 2) ? (i / 2) * 3 + 1 : (i / 2) * 3;
+    fm_get_batch(&map, keys, COUNT * 2, out);
+    for (int i = 0; i < COUNT * 2; i++) {
+        if (i % 2) {
+            assert(out[i] == NULL);
+        } else {
+            assert(out[i] != NULL && *(int*)out[i] == -(i / 2));
+        }
+    }
+
+    free(keys);
+    free(vals);
+    free(out);
+    fm_free(&map);
+    LOG_PASS("Batched Get / Put");
+}
+
+// Random put/erase/get mix checked against a plain array of the key space
+static void fuzz_against_reference(_FastMap* map, int key_space, int ops, uint32_t seed) {
+    int* ref = (int*)malloc(key_space * sizeof(int));
+    for (int i = 0; i < key_space; i++) ref[i] = -1; // -1 = absent
+    size_t live = 0;
+
+    for (int op = 0; op < ops; op++) {
+        seed = seed * 1664525u + 1013904223u;
+        int key = (int)((seed >> 8) % (uint32_t)key_space);
+        uint32_t kind = seed % 20;
+
+        if (kind < 12) {
+            int val = op;
+            fm_put(map, &key, &val);
+            if (ref[key] < 0) live++;
+            ref[key] = val;
+        } else if (kind < 17) {
+            bool erased = fm_erase(map, &key);
+            assert(erased == (ref[key] >= 0));
+            if (erased) live--;
+            ref[key] = -1;
+        } else {
+            int* val = (int*)fm_get(map, &key);
+            assert(ref[key] < 0 ? val == NULL : (val != NULL && *val == ref[key]));
+        }
+        assert(map->keys.length == live);
+    }
+
+    for (int key = 0; key < key_space; key++) {
+        int* val = (int*)fm_get(map, &key);
+        assert(ref[key] < 0 ? val == NULL : (val != NULL && *val == ref[key]));
+    }
+    free(ref);
+}
+
+void test_incremental_resize() {
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS };
+
+    for (int l = 0; l < 3; l++) {
+        fm_options opts = { .flags = FM_OPT_INCREMENTAL | layouts[l] };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+
+        // Lookups and erases must see entries in both tables mid-migration
+        bool saw_migration = false;
+        for (int i = 0; i < 20000; i++) {
+            FM_PUT(&map, int, i, int, i);
+            if (map.migrate_left == 0) continue;
+
+            saw_migration = true;
+            int victim = i / 2;
+            int* v = FM_GET(&map, int, victim);
+            if (v) {
+                assert(*v == victim);
+                assert(FM_DELETE(&map, int, victim));
+                assert(FM_GET(&map, int, victim) == NULL);
+                FM_PUT(&map, int, victim, int, victim);
+            }
+        }
+        assert(saw_migration);
+        for (int i = 0; i < 20000; i++) {
+            int* v = FM_GET(&map, int, i);
+            assert(v != NULL && *v == i);
+        }
+        fm_free(&map);
+
+        map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        fuzz_against_reference(&map, 100000, 300000, 7 + l);
+        fm_free(&map);
+    }
+
+    LOG_PASS("Incremental Resize");
+}
+
+void test_typed_maps() {
+    IntFloatMap ints = IntFloatMap_init();
+    for (int i = 0; i < 20000; i++) IntFloatMap_put(&ints, i, (float)i * 0.5f);
+    IntFloatMap_put(&ints, 7, -1.0f); // Update
+    assert(IntFloatMap_size(&ints) == 20000);
+
+    for (int i = 0; i < 20000; i += 2) assert(IntFloatMap_erase(&ints, i));
+    assert(!IntFloatMap_erase(&ints, 0));
+    assert(IntFloatMap_size(&ints) == 10000);
+
+    for (int i = 0; i < 20000; i++) {
+        float* v = IntFloatMap_get(&ints, i);
+        if (i % 2 == 0) {
+            assert(v == NULL);
+        } else {
+            assert(v != NULL && *v == (i == 7 ? -1.0f : (float)i * 0.5f));
+        }
+    }
+    IntFloatMap_free(&ints);
+
+    // Struct keys through the control-byte layout
+    fm_options opts = { .flags = FM_OPT_CTRL_BYTES };
+    Key16Map structs = Key16Map_init_ex(&opts);
+    for (uint32_t i = 0; i < 5000; i++) {
+        Key16 k = { i, i * 3, ~i, 42 };
+        Vec3 v = { (float)i, 0.0f, 0.0f };
+        Key16Map_put(&structs, k, v);
+    }
+    for (uint32_t i = 0; i < 5000; i++) {
+        Key16 k = { i, i * 3, ~i, 42 };
+        Vec3* v = Key16Map_get(&structs, k);
+        assert(v != NULL && v->x == (float)i);
+        k.d = 43;
+        assert(Key16Map_get(&structs, k) == NULL);
+    }
+    Key16Map_free(&structs);
+
+    LOG_PASS("Typed Maps (FM_DECLARE)");
+}
+
+void test_wide_hash() {
+    unsigned char buf[1024 + 64];
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (unsigned char)(i * 131 + 7);
+
+    // Every dispatch target must agree with the portable version
+    for (size_t len = FM_HASH_WIDE_MIN + 1; len <= 1024; len++) {
+        uint64_t ref = fm_hash_wide_scalar(buf + 3, len);
+        ASSERT_EQ((unsigned long long)ref, (unsigned long long)fm_hash(buf + 3, len), "%llx");
+#if defined(FM_HAVE_SSE2)
+        ASSERT_EQ((unsigned long long)ref, (unsigned long long)fm_hash_wide_sse2(buf + 3, len), "%llx");
+#endif
+    }
+
+    // Swapping two stripes must change the hash
+    unsigned char a[128], b[128];
+    for (int i = 0; i < 128; i++) a[i] = (unsigned char)(i < 64 ? 'x' : 'y');
+    memcpy(b, a + 64, 64);
+    memcpy(b + 64, a, 64);
+    assert(fm_hash(a, 128) != fm_hash(b, 128));
+
+    // 96-byte keys differing in a single byte
+    typedef struct { char url[96]; } UrlKey;
+    _FastMap map = FM_INIT(UrlKey, int);
+    for (int i = 0; i < 5000; i++) {
+        UrlKey k;
+        memset(&k, '/', sizeof(k));
+        snprintf(k.url + 40, 16, "%d", i);
+        fm_put(&map, &k, &i);
+    }
+    for (int i = 0; i < 5000; i++) {
+        UrlKey k;
+        memset(&k, '/', sizeof(k));
+        snprintf(k.url + 40, 16, "%d", i);
+        int* val = (int*)fm_get(&map, &k);
+        assert(val != NULL);
+        ASSERT_EQ(i, *val, "%d");
+    }
+    fm_free(&map);
+    LOG_PASS("Wide Hash (Long Keys)");
+}
+
+void test_stats() {
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS, FM_OPT_INCREMENTAL };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        for (int i = 0; i < 3000; i++) fm_put(&map, &i, &i);
+        for (int i = 0; i < 1000; i++) fm_erase(&map, &i);
+        for (int i = 0; i < 4000; i++) fm_get(&map, &i);
+
+        fm_stats_t st;
+        fm_stats(&map, &st);
+        ASSERT_EQ((size_t)2000, st.size, "%zu");
+        ASSERT_EQ(map.table.bucket_count, st.bucket_count, "%zu");
+        assert(st.load_factor > 0.0 && st.load_factor <= map.max_load_factor);
+
+        size_t hist_total = 0;
+        for (int i = 0; i < FM_STATS_HIST_LEN; i++) hist_total += st.displacement_hist[i];
+        ASSERT_EQ(st.size, hist_total, "%zu");
+        assert(st.mean_probe_length >= 1.0 && st.mean_probe_length <= 1.0 + st.max_displacement);
+
+        ASSERT_EQ(st.bytes_buckets + st.bytes_keys + st.bytes_values + st.bytes_hashes + st.bytes_arena,
+                  st.bytes_total, "%zu");
+        assert(st.bytes_wasted < st.bytes_total);
+
+        ASSERT_EQ(3000ULL, (unsigned long long)st.counters.inserts, "%llu");
+        ASSERT_EQ(1000ULL, (unsigned long long)st.counters.erases, "%llu");
+        ASSERT_EQ(8000ULL, (unsigned long long)st.counters.lookups, "%llu"); // Every put / erase / get searches once
+        assert(st.counters.resizes > 0);
+        assert(st.counters.probes >= st.counters.key_compares);
+        assert(st.counters.key_compares >= 3000); // At least one per hit
+        fm_free(&map);
+    }
+
+    // Erased arena strings count as wasted
+    _FastMap smap = FM_INIT_STR(int);
+    const char* long_key = "a key longer than the inline limit";
+    int v = 1;
+    fm_put_str(&smap, long_key, strlen(long_key), &v);
+    fm_stats_t before, after;
+    fm_stats(&smap, &before);
+    fm_erase_str(&smap, long_key, strlen(long_key));
+    fm_stats(&smap, &after);
+    assert(after.bytes_wasted >= before.bytes_wasted + strlen(long_key));
+    fm_free(&smap);
+
+    LOG_PASS("Statistics (fm_stats)");
+}
+
+void test_reserve() {
+    _FastMap map = fm_init_with_capacity(sizeof(int), sizeof(int), 100000);
+    size_t buckets = map.table.bucket_count;
+    unsigned char* keys = map.keys.data;
+    assert(buckets * map.max_load_factor >= 100000);
+
+    for (int i = 0; i < 100000; i++) fm_put(&map, &i, &i);
+    ASSERT_EQ(buckets, map.table.bucket_count, "%zu");   // No rehash
+    assert(keys == map.keys.data);                       // No realloc
+    ASSERT_EQ(1ULL, (unsigned long long)map.counters.resizes, "%llu"); // Only the one in fm_reserve
+
+    // Reserving on a populated map keeps every entry reachable
+    fm_reserve(&map, 1000000);
+    assert(map.table.bucket_count * map.max_load_factor >= 1000000);
+    for (int i = 0; i < 100000; i++) {
+        int* val = (int*)fm_get(&map, &i);
+        assert(val != NULL);
+        ASSERT_EQ(i, *val, "%d");
+    }
+
+    // Smaller reservations are no-ops
+    buckets = map.table.bucket_count;
+    fm_reserve(&map, 10);
+    ASSERT_EQ(buckets, map.table.bucket_count, "%zu");
+    fm_free(&map);
+    LOG_PASS("Reserve / Init With Capacity");
+}
+
+void test_bulk_build() {
+    int COUNT = 50000;
+    int* keys = (int*)malloc(COUNT * sizeof(int));
+    int* vals = (int*)malloc(COUNT * sizeof(int));
+
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS, FM_OPT_INCREMENTAL };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+
+        // Unique input: then erase half and probe misses, which relies on
+        // the built index being a proper Robin Hood table
+        for (int i = 0; i < COUNT; i++) { keys[i] = i * 7; vals[i] = i; }
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        fm_build(&map, keys, vals, COUNT, FM_BUILD_UNIQUE);
+        ASSERT_EQ((size_t)COUNT, map.keys.length, "%zu");
+
+        // Total linear-probing displacement does not depend on insertion
+        // order, so a per-element build of the same table must match
+        _FastMap ref = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        fm_reserve(&ref, COUNT);
+        for (int i = 0; i < COUNT; i++) fm_put(&ref, &keys[i], &vals[i]);
+        fm_stats_t built, put;
+        fm_stats(&map, &built);
+        fm_stats(&ref, &put);
+        ASSERT_EQ(put.bucket_count, built.bucket_count, "%zu");
+        ASSERT_EQ(put.mean_probe_length, built.mean_probe_length, "%f");
+        fm_free(&ref);
+        for (int i = 0; i < COUNT; i += 2) assert(FM_DELETE(&map, int, i * 7));
+        for (int i = 0; i < COUNT; i++) {
+            int* val = FM_GET(&map, int, i * 7);
+            assert(i % 2 == 0 ? val == NULL : (val != NULL && *val == i));
+            assert(FM_GET(&map, int, i * 7 + 1) == NULL);
+        }
+        fm_free(&map);
+
+        // Duplicates: first position and last value win, as with fm_put
+        for (int i = 0; i < COUNT; i++) { keys[i] = i % 1000; vals[i] = i; }
+        map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        fm_build(&map, keys, vals, COUNT, 0);
+        ASSERT_EQ((size_t)1000, map.keys.length, "%zu");
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_EQ(i, *(int*)fm_vec_at(&map.keys, i), "%d");
+            ASSERT_EQ(COUNT - 1000 + i, *(int*)FM_GET(&map, int, i), "%d");
+        }
+        for (int i = 0; i < 1000; i += 2) assert(FM_DELETE(&map, int, i));
+        for (int i = 1; i < 1000; i += 2) ASSERT_EQ(COUNT - 1000 + i, *(int*)FM_GET(&map, int, i), "%d");
+        fm_free(&map);
+
+        // Building into a populated map takes the fm_put path
+        map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        int one = 1;
+        fm_put(&map, &one, &one);
+        fm_build(&map, keys, vals, 2000, 0);
+        ASSERT_EQ((size_t)1000, map.keys.length, "%zu");
+        ASSERT_EQ(1001, *(int*)FM_GET(&map, int, 1), "%d");
+        fm_free(&map);
+    }
+
+    free(keys);
+    free(vals);
+    LOG_PASS("Bulk Build (fm_build)");
+}
+
+void test_bucket_order_resize() {
+    int COUNT = 200000; // Well past FM_BUCKET_ORDER_MIN, so resizes sweep
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        for (int i = 0; i < COUNT; i++) FM_PUT(&map, int, i * 3, int, i);
+        for (int i = 0; i < COUNT; i += 3) assert(FM_DELETE(&map, int, i * 3));
+        fm_resize(&map, map.table.bucket_count * 2);
+
+        for (int i = 0; i < COUNT; i++) {
+            int* val = FM_GET(&map, int, i * 3);
+            assert(i % 3 == 0 ? val == NULL : (val != NULL && *val == i));
+            assert(FM_GET(&map, int, i * 3 + 1) == NULL);
+        }
+
+        // Same table as the dense-order rebuild, down to total displacement
+        fm_table swept = map.table;
+        map.table = fm_table_alloc(swept.bucket_count, map.flags, map.allocator);
+        assert(fm_rebuild_dense(&map, &map.table));
+        fm_stats_t dense, sweep;
+        fm_stats(&map, &dense);
+        fm_table_free(&map.table);
+        map.table = swept;
+        fm_stats(&map, &sweep);
+        ASSERT_EQ(dense.mean_probe_length, sweep.mean_probe_length, "%f");
+        ASSERT_EQ(dense.max_displacement, sweep.max_displacement, "%u");
+        fm_free(&map);
+    }
+    LOG_PASS("Bucket-Order Resize");
+}
+
+// Serial stand-in for a thread pool: runs tasks back to front
+static size_t hook_calls;
+static void reverse_parallel_for(void* ctx, fm_task_fn fn, void* arg, size_t tasks) {
+    (void)ctx;
+    hook_calls++;
+    for (size_t i = tasks; i-- > 0;) fn(arg, i);
+}
+
+void test_parallel_resize() {
+    int COUNT = FM_PARALLEL_REBUILD_MIN + 4321;
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS, FM_OPT_NO_HASH_CACHE };
+    for (size_t l = 0; l < 2 * sizeof(layouts) / sizeof(layouts[0]); l++) {
+        bool hooked = l % 2;
+        fm_options opts = { .flags = layouts[l / 2], .resize_threads = 4,
+                            .parallel_for = hooked ? reverse_parallel_for : NULL };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        hook_calls = 0;
+        for (int i = 0; i < COUNT; i++) FM_PUT(&map, int, i * 5, int, i);
+        fm_resize(&map, map.table.bucket_count * 2);
+        if (hooked) assert(hook_calls >= 3); // count, scatter, fill
+
+        for (int i = 0; i < COUNT; i++) {
+            int* val = FM_GET(&map, int, i * 5);
+            assert(val != NULL && *val == i);
+            assert(FM_GET(&map, int, i * 5 + 1) == NULL);
+        }
+
+        // Region fix-ups must still yield the dense-order table
+        fm_table swept = map.table;
+        map.table = fm_table_alloc(swept.bucket_count, map.flags, map.allocator);
+        assert(fm_rebuild_dense(&map, &map.table));
+        fm_stats_t dense, sweep;
+        fm_stats(&map, &dense);
+        fm_table_free(&map.table);
+        map.table = swept;
+        fm_stats(&map, &sweep);
+        ASSERT_EQ(dense.mean_probe_length, sweep.mean_probe_length, "%f");
+        ASSERT_EQ(dense.max_displacement, sweep.max_displacement, "%u");
+        fm_free(&map);
+    }
+    LOG_PASS("Parallel Resize");
+}
+
+// Heap for the allocator hooks: checks that every realloc / free is told
+// the size the block really has, tracks live bytes, and once 'fail_every'
+// is set refuses every fail_every-th request
+typedef struct {
+    size_t live;
+    size_t calls;
+    size_t failures;
+    size_t fail_every;
+} test_heap;
+
+static bool heap_refuse(test_heap* h) {
+    h->calls++;
+    if (h->fail_every == 0 || h->calls % h->fail_every != 0) return false;
+    h->failures++;
+    return true;
+}
+
+static void* heap_alloc(void* ctx, size_t size) {
+    test_heap* h = (test_heap*)ctx;
+    if (heap_refuse(h)) return NULL;
+    size_t* block = (size_t*)malloc(size + 16);
+    block[0] = size;
+    h->live += size;
+    return (unsigned char*)block + 16;
+}
+
+static void* heap_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    test_heap* h = (test_heap*)ctx;
+    size_t* block = (size_t*)((unsigned char*)ptr - 16);
+    ASSERT_EQ(block[0], old_size, "%zu");
+    if (heap_refuse(h)) return NULL;
+    block = (size_t*)realloc(block, new_size + 16);
+    block[0] = new_size;
+    h->live = h->live - old_size + new_size;
+    return (unsigned char*)block + 16;
+}
+
+static void heap_free(void* ctx, void* ptr, size_t size) {
+    test_heap* h = (test_heap*)ctx;
+    size_t* block = (size_t*)((unsigned char*)ptr - 16);
+    ASSERT_EQ(block[0], size, "%zu");
+    h->live -= size;
+    free(block);
+}
+
+void test_allocator() {
+    int COUNT = FM_BUCKET_ORDER_MIN * 2; // Large enough for bucket-order rebuild scratch
+    test_heap heap = { 0, 0, 0, 0 };
+    fm_allocator alloc = { heap_alloc, heap_realloc, heap_free, &heap };
+
+    uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS, FM_OPT_INCREMENTAL, FM_OPT_STRING_KEYS };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        bool strings = layouts[l] & FM_OPT_STRING_KEYS;
+        fm_options opts = { .flags = layouts[l], .allocator = &alloc };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+
+        // Every fifth request fails: shed the put and retry it
+        heap.fail_every = 5;
+        heap.failures = 0;
+        char buf[64];
+        const char* str = buf;
+        for (int i = 0; i < COUNT; i++) {
+            int key = i * 3;
+            snprintf(buf, sizeof(buf), "allocator-test-key-%d", key); // Long: lives in the arena
+            const void* k = strings ? (const void*)&str : (const void*)&key;
+            size_t before = map.keys.length;
+            while (!fm_try_put(&map, k, &i)) {
+                ASSERT_EQ(before, map.keys.length, "%zu");
+                assert(fm_get(&map, k) == NULL);
+            }
+        }
+        heap.fail_every = 0;
+        assert(heap.failures > 0);
+        if (!strings) ASSERT_EQ((size_t)0, map.arena.capacity, "%zu"); // No arena without string keys
+
+        ASSERT_EQ((size_t)COUNT, map.keys.length, "%zu");
+        for (int i = 0; i < COUNT; i++) {
+            int key = i * 3;
+            snprintf(buf, sizeof(buf), "allocator-test-key-%d", key);
+            int* val = (int*)fm_get(&map, strings ? (const void*)&str : (const void*)&key);
+            assert(val != NULL && *val == i);
+        }
+        fm_free(&map);
+        ASSERT_EQ((size_t)0, heap.live, "%zu");
+    }
+
+    // Bulk load, explicit resize and typed maps all draw from the hooks too
+    size_t calls = heap.calls;
+    int* keys = (int*)malloc(COUNT * sizeof(int));
+    for (int i = 0; i < COUNT; i++) keys[i] = i;
+    fm_options opts = { .allocator = &alloc };
+    _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+    fm_build(&map, keys, keys, COUNT, FM_BUILD_UNIQUE);
+    fm_resize(&map, map.table.bucket_count * 4);
+    assert(map.table.alloc == &alloc);
+    fm_free(&map);
+    free(keys);
+
+    IntFloatMap typed = IntFloatMap_init_ex(&opts);
+    for (int i = 0; i < 1000; i++) assert(IntFloatMap_try_put(&typed, i, (float)i));
+    assert(*IntFloatMap_get(&typed, 999) == 999.0f);
+    IntFloatMap_free(&typed);
+    assert(heap.calls > calls);
+    ASSERT_EQ((size_t)0, heap.live, "%zu");
+    LOG_PASS("Allocator Hooks / Try Put");
+}
+
+static bool in_block(const _FastMap* map, const void* p, size_t bytes) {
+    const unsigned char* base = map->hashes.data;
+    const unsigned char* q = (const unsigned char*)p;
+    return q >= base && q + bytes <= base + fm_fused_bytes(map) && (uintptr_t)q % FM_FUSED_ALIGN == 0;
+}
+
+void test_fused_layout() {
+    test_heap heap = { 0, 0, 0, 0 };
+    fm_allocator alloc = { heap_alloc, heap_realloc, heap_free, &heap };
+
+    uint32_t layouts[] = { FM_OPT_FUSED, FM_OPT_FUSED | FM_OPT_CTRL_BYTES, FM_OPT_FUSED | FM_OPT_PACKED_BUCKETS,
+                           FM_OPT_FUSED | FM_OPT_INCREMENTAL };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l], .allocator = &alloc };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        assert(!(map.flags & FM_OPT_INCREMENTAL));
+
+        // Each growth is a single allocation: no reallocs, no separate index
+        // (below FM_BUCKET_ORDER_MIN, where rebuilds need no scratch)
+        size_t calls = heap.calls, growths = 0, buckets = map.table.bucket_count;
+        for (int i = 0; i < FM_BUCKET_ORDER_MIN / 2; i++) {
+            FM_PUT(&map, int, i * 7, int, i);
+            if (map.table.bucket_count != buckets) {
+                buckets = map.table.bucket_count;
+                growths++;
+            }
+            ASSERT_EQ(fm_fused_bytes(&map), heap.live, "%zu");
+        }
+        ASSERT_EQ(growths, heap.calls - calls, "%zu");
+        for (int i = FM_BUCKET_ORDER_MIN / 2; i < 50000; i++) FM_PUT(&map, int, i * 7, int, i);
+        ASSERT_EQ(fm_fused_bytes(&map), heap.live, "%zu");
+
+        size_t n = map.keys.capacity, bc = map.table.bucket_count;
+        assert(in_block(&map, map.keys.data, n * sizeof(int)));
+        assert(in_block(&map, map.values.data, n * sizeof(int)));
+        if (map.table.slots) assert(in_block(&map, map.table.slots, bc * sizeof(uint64_t)));
+        else assert(in_block(&map, map.table.buckets, bc * sizeof(uint32_t)));
+        if (map.table.ctrl) assert(in_block(&map, map.table.ctrl, bc + FM_GROUP_WIDTH));
+
+        fm_free(&map);
+        ASSERT_EQ((size_t)0, heap.live, "%zu");
+
+        map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        exercise_int_map(&map);
+        fm_stats_t st;
+        fm_stats(&map, &st);
+        ASSERT_EQ(heap.live, st.bytes_total, "%zu");
+        fm_free(&map);
+    }
+
+    // String keys keep their arena outside the block
+    fm_options str_opts = { .flags = FM_OPT_FUSED };
+    exercise_string_map(&str_opts);
+
+    // Reserve and bulk build size the block up front
+    fm_options opts = { .flags = FM_OPT_FUSED, .allocator = &alloc };
+    _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+    fm_reserve(&map, 30000);
+    size_t calls = heap.calls;
+    for (int i = 0; i < 30000; i++) FM_PUT(&map, int, i, int, i);
+    ASSERT_EQ(calls, heap.calls, "%zu");
+    fm_free(&map);
+
+    int COUNT = FM_BUCKET_ORDER_MIN * 2;
+    int* keys = (int*)malloc(COUNT * sizeof(int));
+    for (int i = 0; i < COUNT; i++) keys[i] = i * 5;
+    map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+    fm_build(&map, keys, keys, COUNT, FM_BUILD_UNIQUE);
+    for (int i = 0; i < COUNT; i++) assert(*(int*)FM_GET(&map, int, i * 5) == i * 5);
+
+    // A refused block leaves the map untouched
+    heap.fail_every = 3;
+    for (int i = 0; i < COUNT; i++) {
+        int key = -1 - i;
+        size_t before = map.keys.length;
+        while (!fm_try_put(&map, &key, &i)) ASSERT_EQ(before, map.keys.length, "%zu");
+    }
+    heap.fail_every = 0;
+    assert(heap.failures > 0);
+    ASSERT_EQ((size_t)COUNT * 2, map.keys.length, "%zu");
+    for (int i = 0; i < COUNT; i++) assert(*(int*)FM_GET(&map, int, -1 - i) == i && *(int*)FM_GET(&map, int, i * 5) == i * 5);
+    fm_free(&map);
+    free(keys);
+    ASSERT_EQ((size_t)0, heap.live, "%zu");
+    LOG_PASS("Fused Layout (one block per map)");
+}
+
+void test_small_maps() {
+    test_heap heap = { 0, 0, 0, 0 };
+    fm_allocator alloc = { heap_alloc, heap_realloc, heap_free, &heap };
+
+    uint32_t layouts[] = { FM_OPT_SMALL, FM_OPT_SMALL | FM_OPT_CTRL_BYTES, FM_OPT_SMALL | FM_OPT_PACKED_BUCKETS,
+                           FM_OPT_SMALL | FM_OPT_INCREMENTAL, FM_OPT_SMALL | FM_OPT_FUSED };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+        fm_options hooked = { .flags = layouts[l], .allocator = &alloc };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &hooked);
+        ASSERT_EQ((size_t)0, heap.calls, "%zu"); // Nothing until the first put
+        assert(FM_GET(&map, int, 1) == NULL && !FM_DELETE(&map, int, 1));
+
+        // Up to FM_SMALL_MAX entries: one block, no index, scans find them
+        for (int i = 0; i < FM_SMALL_MAX - 1; i++) FM_PUT(&map, int, i * 7, int, i);
+        FM_PUT(&map, int, 0, int, 100); // Update in place
+        assert(FM_DELETE(&map, int, 3 * 7) && !FM_DELETE(&map, int, 3 * 7));
+        FM_PUT(&map, int, 3 * 7, int, 3);
+        FM_PUT(&map, int, (FM_SMALL_MAX - 1) * 7, int, FM_SMALL_MAX - 1);
+        for (int i = 0; i < FM_SMALL_MAX; i++) ASSERT_EQ(i ? i : 100, *(int*)FM_GET(&map, int, i * 7), "%d");
+        assert(FM_GET(&map, int, 1) == NULL);
+        ASSERT_EQ((size_t)1, heap.calls, "%zu");
+        ASSERT_EQ((size_t)0, map.table.bucket_count, "%zu");
+
+        // One more switches to the regular index
+        FM_PUT(&map, int, FM_SMALL_MAX * 7, int, FM_SMALL_MAX);
+        ASSERT_EQ((size_t)16, map.table.bucket_count, "%zu");
+        for (int i = 1; i <= FM_SMALL_MAX; i++) ASSERT_EQ(i, *(int*)FM_GET(&map, int, i * 7), "%d");
+        fm_free(&map);
+        ASSERT_EQ((size_t)0, heap.live, "%zu");
+        heap.calls = 0;
+
+        map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        exercise_int_map(&map);
+        fm_free(&map);
+    }
+    fm_options opts = { .flags = FM_OPT_SMALL };
+    exercise_string_map(&opts);
+
+    // Reserve, bulk build and batches start from a small map too
+    int keys[100];
+    void* out[100];
+    for (int i = 0; i < 100; i++) keys[i] = i * 3;
+    _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+    fm_reserve(&map, 5);
+    ASSERT_EQ((size_t)0, map.table.bucket_count, "%zu");
+    fm_put_batch(&map, keys, keys, 5);
+    fm_get_batch(&map, keys, 6, out);
+    assert(*(int*)out[4] == 12 && out[5] == NULL);
+    fm_put_batch(&map, keys, keys, 100);
+    fm_get_batch(&map, keys, 100, out);
+    for (int i = 0; i < 100; i++) assert(*(int*)out[i] == i * 3);
+    fm_free(&map);
+
+    map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+    fm_build(&map, keys, keys, 100, FM_BUILD_UNIQUE);
+    ASSERT_EQ((size_t)100, map.keys.length, "%zu");
+    for (int i = 0; i < 100; i++) assert(*(int*)FM_GET(&map, int, i * 3) == i * 3);
+    fm_free(&map);
+
+    // A refused block, first or promoted, leaves the map as it was
+    fm_options hooked = { .flags = FM_OPT_SMALL, .allocator = &alloc };
+    map = fm_init_ex(sizeof(int), sizeof(int), &hooked);
+    heap.fail_every = 5;
+    for (int i = 0; i < 100; i++) {
+        size_t before = map.keys.length;
+        while (!fm_try_put(&map, &keys[i], &i)) ASSERT_EQ(before, map.keys.length, "%zu");
+    }
+    heap.fail_every = 0;
+    assert(heap.failures > 0);
+    for (int i = 0; i < 100; i++) assert(*(int*)FM_GET(&map, int, i * 3) == i);
+    fm_free(&map);
+    ASSERT_EQ((size_t)0, heap.live, "%zu");
+    LOG_PASS("Small Maps (scan, then index)");
+}
+
+void test_index_width() {
+    // A packed slot round-trips the largest index it can hold
+    uint64_t slot = fm_slot_make((fm_index)FM_SLOT_IDX_MASK, ~0ULL, 3);
+    fm_table view = { NULL, NULL, &slot, 1, 0, NULL, sizeof(fm_index) };
+    ASSERT_EQ((unsigned long long)FM_SLOT_IDX_MASK, (unsigned long long)fm_bucket_index(&view, 0), "%llu");
+    ASSERT_EQ(3u, fm_slot_dist(slot), "%u");
+
+    // Growth past what the index can address is refused up front (nothing
+    // is allocated) and the map stays usable
+    uint32_t layouts[] = { 0, FM_OPT_PACKED_BUCKETS, FM_OPT_PACKED_BUCKETS | FM_OPT_INCREMENTAL };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        for (int i = 0; i < 1000; i++) FM_PUT(&map, int, i, int, i);
+
+        size_t limit = 16;
+        while (limit < ((size_t)1 << 56) && fm_index_fits(&map, limit * 2)) limit *= 2;
+#if !defined(FM_INDEX_64)
+        ASSERT_EQ((size_t)1 << 32, limit, "%zu"); // 3.4 billion entries at the default load factor
+#else
+        if (!(layouts[l] & FM_OPT_PACKED_BUCKETS)) { // 64-bit plain buckets: no practical limit
+            fm_free(&map);
+            continue;
+        }
+        ASSERT_EQ((size_t)1 << 40, limit, "%zu");
+#endif
+        size_t buckets = map.table.bucket_count;
+        assert(!fm_try_resize(&map, limit * 2));
+        ASSERT_EQ(buckets, map.table.bucket_count, "%zu");
+        for (int i = 0; i < 1000; i++) assert(*(int*)FM_GET(&map, int, i) == i);
+        fm_free(&map);
+    }
+    LOG_PASS(sizeof(fm_index) == 8 ? "Index Width (64-bit, FM_INDEX_64)" : "Index Width (32-bit)");
+}
+
+void test_compact_index() {
+    uint32_t layouts[] = { FM_OPT_COMPACT_INDEX, FM_OPT_COMPACT_INDEX | FM_OPT_INCREMENTAL,
+                           FM_OPT_COMPACT_INDEX | FM_OPT_FUSED, FM_OPT_COMPACT_INDEX | FM_OPT_SMALL };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+
+        // The index widens as the table grows, and every entry stays reachable
+        int n = 0;
+        size_t widths[] = { 1, 2, 4 };
+        size_t limits[] = { (size_t)1 << 8, (size_t)1 << 16, (size_t)1 << 18 };
+        for (size_t w = 0; w < 3; w++) {
+            for (; map.table.bucket_count < limits[w] / 2 || n < 200; n++) FM_PUT(&map, int, n, int, n);
+            fm_stats_t st;
+            fm_stats(&map, &st);
+            if (map.table.bucket_count <= limits[w]) {
+                ASSERT_EQ(widths[w], map.table.width, "%zu");
+                if (!(layouts[l] & FM_OPT_INCREMENTAL)) {
+                    ASSERT_EQ(map.table.bucket_count * widths[w], st.bytes_buckets, "%zu");
+                }
+            }
+            for (int i = 0; i < n; i++) assert(*(int*)FM_GET(&map, int, i) == i);
+        }
+        fm_free(&map);
+
+        map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        exercise_int_map(&map);
+        fm_free(&map);
+    }
+    fm_options opts = { .flags = FM_OPT_COMPACT_INDEX };
+    exercise_string_map(&opts);
+
+    // Control bytes and packed slots keep their own formats
+    uint32_t others[] = { FM_OPT_COMPACT_INDEX | FM_OPT_CTRL_BYTES, FM_OPT_COMPACT_INDEX | FM_OPT_PACKED_BUCKETS };
+    for (size_t l = 0; l < sizeof(others) / sizeof(others[0]); l++) {
+        fm_options o = { .flags = others[l] };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &o);
+        ASSERT_EQ(sizeof(fm_index), map.table.width, "%zu");
+        exercise_int_map(&map);
+        fm_free(&map);
+    }
+    LOG_PASS("Compact Index (8/16-bit buckets)");
+}
+
+void test_hash_cache() {
+    uint32_t layouts[] = { FM_OPT_NO_HASH_CACHE, FM_OPT_NO_HASH_CACHE | FM_OPT_CTRL_BYTES,
+                           FM_OPT_NO_HASH_CACHE | FM_OPT_PACKED_BUCKETS, FM_OPT_NO_HASH_CACHE | FM_OPT_INCREMENTAL,
+                           FM_OPT_NO_HASH_CACHE | FM_OPT_COMPACT_INDEX };
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        fm_options opts = { .flags = layouts[l] };
+        _FastMap map = fm_init_ex(sizeof(int), sizeof(int), &opts);
+        exercise_int_map(&map); // Crosses FM_BUCKET_ORDER_MIN, so both rebuilds run
+
+        // Nothing cached, and the recomputed hashes are the ones the index was built from
+        fm_stats_t st;
+        fm_stats(&map, &st);
+        ASSERT_EQ((size_t)0, st.bytes_hashes, "%zu");
+        ASSERT_EQ((size_t)0, map.hashes.length, "%zu");
+        for (size_t i = 0; i < map.keys.length; i++) {
+            ASSERT_EQ((unsigned long long)fm_hash(fm_vec_at(&map.keys, i), sizeof(int)),
+                      (unsigned long long)fm_hash_at(&map, i), "%llu");
+        }
+        fm_free(&map);
+    }
+
+    // Odd key sizes, bulk build with duplicates, batches and fm_try_put
+    typedef struct { uint64_t a, b; uint16_t c; } wide_key;
+    fm_options opts = { .flags = FM_OPT_NO_HASH_CACHE };
+    int n = 20000;
+    wide_key* keys = (wide_key*)calloc((size_t)n, sizeof(wide_key));
+    int* vals = (int*)malloc((size_t)n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        keys[i].a = (uint64_t)(i % (n / 2)); // Every key twice; the later value wins
+        keys[i].b = ~keys[i].a;
+        vals[i] = i;
+    }
+    _FastMap map = fm_init_ex(sizeof(wide_key), sizeof(int), &opts);
+    fm_build(&map, keys, vals, (size_t)n, 0);
+    ASSERT_EQ((size_t)n / 2, map.keys.length, "%zu");
+    for (int i = 0; i < n / 2; i++) assert(*(int*)fm_get(&map, &keys[i]) == i + n / 2);
+    void* out[64];
+    fm_get_batch(&map, keys, 64, out);
+    for (int i = 0; i < 64; i++) assert(*(int*)out[i] == i + n / 2);
+    for (int i = 0; i < n / 2; i += 2) assert(fm_erase(&map, &keys[i]));
+    fm_put_batch(&map, keys, vals, 64);
+    for (int i = 0; i < n / 2; i++) {
+        int* v = (int*)fm_get(&map, &keys[i]);
+        assert(i < 64 ? *v == i : (i % 2 == 0 ? v == NULL : *v == i + n / 2));
+    }
+    fm_free(&map);
+
+    map = fm_init_ex(sizeof(wide_key), sizeof(int), &opts);
+    fm_reserve(&map, (size_t)n / 2);
+    for (int i = 0; i < n / 2; i++) assert(fm_try_put(&map, &keys[i], &vals[i]));
+    for (int i = 0; i < n / 2; i++) assert(*(int*)fm_get(&map, &keys[i]) == i);
+    ASSERT_EQ((size_t)0, map.hashes.capacity, "%zu");
+    fm_free(&map);
+    free(keys);
+    free(vals);
+
+    // Layouts built around the cached hashes keep them
+    uint32_t kept[] = { FM_OPT_STRING_KEYS, FM_OPT_FUSED, FM_OPT_SMALL };
+    for (size_t l = 0; l < sizeof(kept) / sizeof(kept[0]); l++) {
+        fm_options o = { .flags = kept[l] | FM_OPT_NO_HASH_CACHE };
+        map = fm_init_ex(sizeof(int), sizeof(int), &o);
+        assert(fm_caches_hashes(&map));
+        fm_free(&map);
+    }
+    LOG_PASS("Hash Cache Off (recomputed hashes)");
+}
+
+// Chi-square of 'n' samples over 'cells' equally likely cells
+static double chi_square(const uint32_t* counts, size_t cells, size_t n) {
+    double expect = (double)n / (double)cells, chi = 0.0;
+    for (size_t c = 0; c < cells; c++) chi += ((double)counts[c] - expect) * ((double)counts[c] - expect) / expect;
+    return chi;
+}
+
+void test_hash_backends() {
+    fm_hash_kind kinds[] = { FM_HASH_WY, FM_HASH_CRC32C, FM_HASH_AES, FM_HASH_MULSHIFT, FM_HASH_FAST };
+    size_t n = 1 << 16;
+    uint32_t* low = (uint32_t*)malloc(4096 * sizeof(uint32_t));
+    uint32_t tags[128];
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        fm_options opts = { .hash = kinds[k] };
+        _FastMap map = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+        ASSERT_EQ((int)fm_hash_resolve(kinds[k]), (int)map.hash_kind, "%d");
+        assert(map.hash_kind != FM_HASH_FAST);
+        fm_free(&map);
+
+        // Quality: home buckets (low bits) and control tags / fingerprints
+        // (top bits) spread evenly, and Robin Hood displacement stays short,
+        // for sequential, pointer-like and high-stride keys
+        for (int pattern = 0; pattern < 3; pattern++) {
+            map = fm_init_ex(sizeof(uint64_t), sizeof(uint64_t), &opts);
+            memset(low, 0, 4096 * sizeof(uint32_t));
+            memset(tags, 0, sizeof(tags));
+            for (uint64_t i = 0; i < n; i++) {
+                uint64_t key = pattern == 0 ? i : pattern == 1 ? 0x7f3a00001000ULL + i * 64 : i << 20;
+                uint64_t h = fm_map_hash(&map, &key);
+                low[h & 4095]++;
+                tags[h >> 57]++;
+                fm_put(&map, &key, &i);
+            }
+            fm_stats_t st;
+            fm_stats(&map, &st);
+            assert(chi_square(low, 4096, n) < 4096 * 1.3);
+            assert(chi_square(tags, 128, n) < 128 * 2.0);
+            assert(st.mean_probe_length < 2.5);
+            assert(st.max_displacement < 64);
+            fm_free(&map);
+        }
+
+        // Every layout and path that hashes or rehashes agrees with the backend
+        uint32_t layouts[] = { 0, FM_OPT_CTRL_BYTES, FM_OPT_PACKED_BUCKETS, FM_OPT_INCREMENTAL,
+                               FM_OPT_NO_HASH_CACHE, FM_OPT_SMALL };
+        for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+            fm_options o = { .flags = layouts[l], .hash = kinds[k] };
+            map = fm_init_ex(sizeof(int), sizeof(int), &o);
+            exercise_int_map(&map);
+            fm_free(&map);
+        }
+
+        // Odd and long key sizes; past FM_HASH_SHORT_MAX bytes it is fm_hash
+        size_t sizes[] = { 3, 12, 16, 24 };
+        for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+            size_t ks = sizes[z];
+            unsigned char* keys = (unsigned char*)calloc(1000, ks);
+            int vals[1000];
+            for (int i = 0; i < 1000; i++) {
+                memcpy(keys + (size_t)i * ks, &i, 2);
+                keys[(size_t)i * ks + ks - 1] = (unsigned char)(i >> 2);
+                vals[i] = i;
+            }
+            map = fm_init_ex(ks, sizeof(int), &opts);
+            fm_build(&map, keys, vals, 1000, FM_BUILD_UNIQUE);
+            for (int i = 0; i < 1000; i++) assert(*(int*)fm_get(&map, keys + (size_t)i * ks) == i);
+            if (ks > FM_HASH_SHORT_MAX) {
+                ASSERT_EQ((unsigned long long)fm_hash(keys, ks), (unsigned long long)fm_map_hash(&map, keys), "%llu");
+            }
+            fm_free(&map);
+            free(keys);
+        }
+    }
+    free(low);
+
+    // String keys hash by content with fm_hash whatever is asked for
+    fm_options opts = { .hash = FM_HASH_CRC32C };
+    _FastMap smap = fm_init_str(sizeof(int), &opts);
+    ASSERT_EQ((int)FM_HASH_WY, (int)smap.hash_kind, "%d");
+    fm_free(&smap);
+    LOG_PASS("Hash Backends (quality and dispatch)");
+}
+
 int main() {
     printf("=== FastMap Test Suite ===\n");
     
     test_basic_int_map();
     test_string_keys();
+    test_string_arena();
     test_struct_values();
     test_deletion_integrity();
     test_massive_resize();
+    test_ctrl_bytes();
+    test_packed_buckets();
+    test_batch_api();
+    test_incremental_resize();
+    test_typed_maps();
+    test_wide_hash();
+    test_stats();
+    test_reserve();
+    test_bulk_build();
+    test_bucket_order_resize();
+    test_parallel_resize();
+    test_allocator();
+    test_fused_layout();
+    test_small_maps();
+    test_index_width();
+    test_compact_index();
+    test_hash_cache();
+    test_hash_backends();
 
     printf("=== All Tests Passed ===\n");
     return 0;